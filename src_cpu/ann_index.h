@@ -0,0 +1,218 @@
+/*
+ * Approximate nearest-neighbor index over node embeddings.
+ * An inverted file (IVF): the embedding rows are clustered by spherical
+ * k-means (kmeans.h) and every cluster keeps the list of its rows. A query
+ * only scans the rows of the nprobe clusters closest to it.
+ *
+ * Stored next to the embedding file as <embedding file>.ivf (native
+ * endianness): magic, nlist, dim, count, emb_hash (uint64_t, FNV-1a of
+ * the embedding file, so an index left over from other embeddings is
+ * rejected), centroids[nlist * dim] (float), list_offsets[nlist + 1]
+ * (int64_t), list_rows[count] (int64_t).
+ */
+
+const char kIVFFileMagic[8] = {'R', 'W', 'I', 'V', 'F', '0', '0', '2'};
+
+class IVFIndex {
+ public:
+  // Clusters the (normalized) rows of emb into nlist inverted lists
+  void Build(const EmbeddingTable &emb, int nlist, int kmeans_iter) {
+    Timer t;
+    t.Start();
+    nlist_ = std::min<int64_t>(nlist, emb.count());
+    dim_ = emb.dim();
+    count_ = emb.count();
+    std::vector<float> inv_norm = InverseRowNorms(emb);
+    std::vector<float> unit_rows(count_ * dim_);
+    #pragma omp parallel for schedule(static)
+    for (int64_t r = 0; r < count_; r++)
+      for (int64_t d = 0; d < dim_; d++)
+        unit_rows[r * dim_ + d] = emb.row(r)[d] * inv_norm[r];
+    std::vector<int> assignment;
+    SphericalKMeans(unit_rows.data(), count_, dim_, nlist_, kmeans_iter,
+                    /* tol */ 1e-3, /* seed */ 1, &assignment, &centroids_);
+
+    // Rows grouped by cluster, in increasing row order within a list
+    list_offsets_.assign(nlist_ + 1, 0);
+    for (int64_t r = 0; r < count_; r++)
+      list_offsets_[assignment[r] + 1]++;
+    for (int64_t l = 0; l < nlist_; l++)
+      list_offsets_[l + 1] += list_offsets_[l];
+    list_rows_.resize(count_);
+    std::vector<int64_t> fill(list_offsets_.begin(), list_offsets_.end() - 1);
+    for (int64_t r = 0; r < count_; r++)
+      list_rows_[fill[assignment[r]]++] = r;
+    t.Stop();
+    std::cout << "Built IVF index with " << nlist_ << " lists over "
+              << count_ << " embeddings" << std::endl;
+    PrintStep("[TimingStat] ANN index build time (s):", t.Seconds());
+  }
+
+  // Stores the index next to the embedding file it was built from
+  void Save(std::string emb_filename) const {
+    std::string filename = emb_filename + ".ivf";
+    uint64_t emb_hash = HashFile(emb_filename);
+    std::ofstream out(filename, std::ios::out | std::ios::binary);
+    if (!out) {
+      std::cout << "Couldn't write ANN index " << filename << std::endl;
+      std::exit(-81);
+    }
+    out.write(kIVFFileMagic, sizeof(kIVFFileMagic));
+    out.write(reinterpret_cast<const char*>(&nlist_), sizeof(nlist_));
+    out.write(reinterpret_cast<const char*>(&dim_), sizeof(dim_));
+    out.write(reinterpret_cast<const char*>(&count_), sizeof(count_));
+    out.write(reinterpret_cast<const char*>(&emb_hash), sizeof(emb_hash));
+    out.write(reinterpret_cast<const char*>(centroids_.data()), nlist_ * dim_ * sizeof(float));
+    out.write(reinterpret_cast<const char*>(list_offsets_.data()), (nlist_ + 1) * sizeof(int64_t));
+    out.write(reinterpret_cast<const char*>(list_rows_.data()), count_ * sizeof(int64_t));
+  }
+
+  // Loads the index stored next to emb_filename, whose table is emb;
+  // returns false if there is none
+  bool Load(std::string emb_filename, const EmbeddingTable &emb) {
+    std::string filename = emb_filename + ".ivf";
+    std::ifstream in(filename, std::ios::in | std::ios::binary);
+    if (!in)
+      return false;
+    char magic[sizeof(kIVFFileMagic)];
+    uint64_t emb_hash = 0;
+    in.read(magic, sizeof(magic));
+    in.read(reinterpret_cast<char*>(&nlist_), sizeof(nlist_));
+    in.read(reinterpret_cast<char*>(&dim_), sizeof(dim_));
+    in.read(reinterpret_cast<char*>(&count_), sizeof(count_));
+    in.read(reinterpret_cast<char*>(&emb_hash), sizeof(emb_hash));
+    if (!in || memcmp(magic, kIVFFileMagic, sizeof(magic)) != 0 ||
+        dim_ != emb.dim() || count_ != emb.count() ||
+        emb_hash != HashFile(emb_filename)) {
+      std::cout << filename << " is not an ANN index of these embeddings" << std::endl;
+      std::exit(-82);
+    }
+    // Every row is in exactly one of nlist non-overlapping lists
+    bool valid = nlist_ >= (count_ > 0 ? 1 : 0) && nlist_ <= count_;
+    if (valid) {
+      centroids_.resize(nlist_ * dim_);
+      list_offsets_.resize(nlist_ + 1);
+      list_rows_.resize(count_);
+      in.read(reinterpret_cast<char*>(centroids_.data()), nlist_ * dim_ * sizeof(float));
+      in.read(reinterpret_cast<char*>(list_offsets_.data()), (nlist_ + 1) * sizeof(int64_t));
+      in.read(reinterpret_cast<char*>(list_rows_.data()), count_ * sizeof(int64_t));
+      valid = !in.fail() && list_offsets_[0] == 0 && list_offsets_[nlist_] == count_;
+    }
+    for (int64_t l = 0; valid && l < nlist_; l++)
+      valid = list_offsets_[l] <= list_offsets_[l + 1];
+    for (int64_t o = 0; valid && o < count_; o++)
+      valid = list_rows_[o] >= 0 && list_rows_[o] < count_;
+    if (!valid) {
+      std::cout << "ANN index " << filename << " is corrupt or truncated" << std::endl;
+      std::exit(-83);
+    }
+    std::cout << "Loaded IVF index with " << nlist_ << " lists from "
+              << filename << std::endl;
+    return true;
+  }
+
+  int64_t nlist() const { return nlist_; }
+
+  /*
+    Same contract as RetrieveTopK(), but each query only scans the rows
+    of its nprobe closest lists. Queries are processed in parallel.
+  */
+  std::vector<LinkCandidates> Search(
+    const EmbeddingTable &emb,
+    const std::vector<NodeID> &queries,
+    size_t k,
+    int nprobe,
+    const WGraph *g) const
+  {
+    std::vector<float> inv_norm = InverseRowNorms(emb);
+    std::vector<LinkCandidates> results(queries.size());
+    #pragma omp parallel for schedule(dynamic, 16)
+    for (size_t i = 0; i < queries.size(); i++) {
+      NodeID src = queries[i];
+      int64_t q_row = emb.RowOf(src);
+      if (q_row == -1)
+        continue;
+      const float *qv = emb.row(q_row);
+
+      // Closest lists by centroid similarity
+      TopKHeap<int64_t, float> probe(nprobe);
+      for (int64_t l = 0; l < nlist_; l++) {
+        const float *cv = centroids_.data() + l * dim_;
+        float dot = 0;
+        #pragma omp simd reduction(+:dot)
+        for (int64_t d = 0; d < dim_; d++)
+          dot += qv[d] * cv[d];
+        probe.Push(l, dot);
+      }
+
+      LinkHeap heap(k);
+      for (auto &lp : probe.Sorted()) {
+        int64_t l = lp.second;
+        for (int64_t o = list_offsets_[l]; o < list_offsets_[l + 1]; o++) {
+          int64_t r = list_rows_[o];
+          if (r == q_row)
+            continue;
+          const float *rv = emb.row(r);
+          float dot = 0;
+          #pragma omp simd reduction(+:dot)
+          for (int64_t d = 0; d < dim_; d++)
+            dot += qv[d] * rv[d];
+          float s = dot * inv_norm[q_row] * inv_norm[r];
+          if (!heap.Accepts(s))
+            continue;
+          NodeID dst = emb.id(r);
+          if ((g != nullptr) && (src < g->num_nodes()) &&
+              (dst < g->num_nodes()) && g->EdgeExists(src, dst))
+            continue;
+          heap.Push(dst, s);
+        }
+      }
+      results[i] = heap.Sorted();
+    }
+    return results;
+  }
+
+ private:
+  int64_t nlist_ = 0;
+  int64_t dim_ = 0;
+  int64_t count_ = 0;
+  std::vector<float> centroids_;
+  std::vector<int64_t> list_offsets_;
+  std::vector<int64_t> list_rows_;
+};
+
+/*
+  Builds the ANN index of a written embedding file and stores it next to it
+*/
+void BuildEmbeddingIndex(std::string emb_filename, int nlist, int kmeans_iter)
+{
+  EmbeddingTable emb(emb_filename);
+  IVFIndex index;
+  index.Build(emb, nlist, kmeans_iter);
+  index.Save(emb_filename);
+}
+
+/*
+  Fraction of the exact top-K neighbors that the approximate search found,
+  averaged over all queries that have neighbors
+*/
+double RecallAtK(
+  const std::vector<LinkCandidates> &exact,
+  const std::vector<LinkCandidates> &approx)
+{
+  double recall_sum = 0;
+  int64_t num_queries = 0;
+  for (size_t i = 0; i < exact.size(); i++) {
+    if (exact[i].empty())
+      continue;
+    std::set<NodeID> found;
+    for (auto &c : approx[i])
+      found.insert(c.second);
+    int64_t hits = 0;
+    for (auto &c : exact[i])
+      hits += found.count(c.second);
+    recall_sum += (double) hits / exact[i].size();
+    num_queries++;
+  }
+  return num_queries > 0 ? recall_sum / num_queries : 0;
+}
@@ -0,0 +1,234 @@
+/*
+ * Content-addressed cache for the outputs of the link prediction stages.
+ * Every stage artifact (CSR, walk corpus, embeddings, sampled pair lists)
+ * is stored under a key that hashes the input file contents, the params
+ * the stage depends on, the random seed and the key of the stage it was
+ * computed from, so a later run reuses whatever upstream work is still valid.
+ * Artifacts are written to a temporary file and renamed into place when
+ * complete, so an interrupted run never leaves a partial artifact behind.
+ */
+
+#include <cinttypes>
+#include <sys/stat.h>
+#include <sys/types.h>
+
+std::string HexKey(uint64_t hash)
+{
+  char buf[17];
+  snprintf(buf, sizeof(buf), "%016" PRIx64, hash);
+  return std::string(buf);
+}
+
+/*
+  Keys of the individual stages. A stage key chains the key of the stage
+  it consumes with the params that change its output.
+*/
+std::string StageKey(
+  std::string stage,
+  std::string parent_key,
+  std::vector<std::string> params)
+{
+  std::string desc = stage + "|" + parent_key;
+  for (auto &p : params)
+    desc += "|" + p;
+  return HexKey(HashBytes(desc.data(), desc.size()));
+}
+
+template<typename T>
+std::string KeyParam(std::string name, T value)
+{
+  std::ostringstream s;
+  s << name << "=" << value;
+  return s.str();
+}
+
+class ArtifactCache {
+ public:
+  explicit ArtifactCache(std::string dir) : dir_(dir) {
+    if (enabled())
+      mkdir(dir_.c_str(), 0755);
+  }
+
+  bool enabled() const { return !dir_.empty(); }
+
+  std::string Path(std::string stage, std::string key) const {
+    return dir_ + "/" + stage + "-" + key + ".bin";
+  }
+
+  // Artifacts are written here and moved to Path() by Commit()
+  std::string TempPath(std::string stage, std::string key) const {
+    return Path(stage, key) + ".tmp";
+  }
+
+  void Commit(std::string stage, std::string key) const {
+    if (std::rename(TempPath(stage, key).c_str(), Path(stage, key).c_str()) != 0)
+      std::cout << "[Cache] Couldn't store " << Path(stage, key) << std::endl;
+  }
+
+  bool Has(std::string stage, std::string key) const {
+    struct stat st;
+    bool hit = enabled() && (stat(Path(stage, key).c_str(), &st) == 0);
+    std::cout << "[Cache] " << stage << " " << key << (hit ? " hit" : " miss")
+              << std::endl;
+    return hit;
+  }
+
+ private:
+  std::string dir_;
+};
+
+/*
+  CSR artifact: header {magic, directed, num_nodes, num_neighbors}, then
+  out offsets and neighbors, in offsets and neighbors if directed, and
+  finally the input edge list (used by the data pre-processing stage)
+*/
+const char kCSRFileMagic[8] = {'R', 'W', 'C', 'S', 'R', '0', '0', '1'};
+
+void SaveGraphArtifact(const WGraph &g, const EdgeList &el, std::string filename)
+{
+  std::ofstream out(filename, std::ios::out | std::ios::binary);
+  int64_t directed = g.directed();
+  int64_t num_nodes = g.num_nodes();
+  pvector<SGOffset> offsets = g.VertexOffsets(false);
+  int64_t num_neighs = offsets[num_nodes];
+  out.write(kCSRFileMagic, sizeof(kCSRFileMagic));
+  out.write(reinterpret_cast<char*>(&directed), sizeof(directed));
+  out.write(reinterpret_cast<char*>(&num_nodes), sizeof(num_nodes));
+  out.write(reinterpret_cast<char*>(&num_neighs), sizeof(num_neighs));
+  out.write(reinterpret_cast<char*>(offsets.data()), (num_nodes + 1) * sizeof(SGOffset));
+  out.write(reinterpret_cast<char*>(g.out_neigh(0).begin()), num_neighs * sizeof(WNode));
+  if (directed) {
+    offsets = g.VertexOffsets(true);
+    out.write(reinterpret_cast<char*>(offsets.data()), (num_nodes + 1) * sizeof(SGOffset));
+    out.write(reinterpret_cast<char*>(g.in_neigh(0).begin()), num_neighs * sizeof(WNode));
+  }
+  int64_t num_el = el.size();
+  out.write(reinterpret_cast<char*>(&num_el), sizeof(num_el));
+  out.write(reinterpret_cast<const char*>(el.data()), num_el * sizeof(EdgeP));
+}
+
+// Reads len bytes, false if the file ends first
+bool ReadBytes(std::ifstream &in, void *data, int64_t len)
+{
+  in.read(reinterpret_cast<char*>(data), len);
+  return in.gcount() == len;
+}
+
+// Bytes of in after the current position
+int64_t BytesLeft(std::ifstream &in)
+{
+  std::streampos pos = in.tellg();
+  in.seekg(0, std::ios::end);
+  int64_t left = in.tellg() - pos;
+  in.seekg(pos);
+  return left;
+}
+
+bool ReadCachedEdgeList(std::ifstream &in, EdgeList *el)
+{
+  int64_t num_el;
+  if (!ReadBytes(in, &num_el, sizeof(num_el)) || num_el < 0 ||
+      num_el > BytesLeft(in) / (int64_t) sizeof(EdgeP))
+    return false;
+  el->resize(num_el);
+  return ReadBytes(in, el->data(), num_el * sizeof(EdgeP));
+}
+
+// Reads offsets and neighbors of one direction, false if truncated
+bool ReadCachedNeighbors(
+  std::ifstream &in,
+  pvector<SGOffset> &offsets,
+  int64_t num_neighs,
+  WNode **neighs)
+{
+  *neighs = nullptr;
+  if (!ReadBytes(in, offsets.data(), offsets.size() * sizeof(SGOffset)) ||
+      num_neighs > BytesLeft(in) / (int64_t) sizeof(WNode))
+    return false;
+  *neighs = new WNode[num_neighs];
+  return ReadBytes(in, *neighs, num_neighs * sizeof(WNode));
+}
+
+/*
+  Loads a CSR artifact into g and el. A truncated artifact (e.g. from a
+  cache written before the writes were made atomic) is a cache miss.
+*/
+bool LoadGraphArtifact(std::string filename, WGraph *g, EdgeList *el)
+{
+  Timer t;
+  t.Start();
+  std::ifstream in(filename, std::ios::in | std::ios::binary);
+  char magic[sizeof(kCSRFileMagic)];
+  int64_t directed, num_nodes, num_neighs;
+  in.read(magic, sizeof(magic));
+  if (in && memcmp(magic, kCSRFileMagic, sizeof(magic)) != 0) {
+    std::cout << filename << " is not a cached graph" << std::endl;
+    std::exit(-52);
+  }
+  WNode *neighs = nullptr, *inv_neighs = nullptr;
+  bool complete = in &&
+    ReadBytes(in, &directed, sizeof(directed)) &&
+    ReadBytes(in, &num_nodes, sizeof(num_nodes)) &&
+    ReadBytes(in, &num_neighs, sizeof(num_neighs)) &&
+    num_nodes >= 0 && num_neighs >= 0 &&
+    num_nodes < BytesLeft(in) / (int64_t) sizeof(SGOffset);
+  pvector<SGOffset> offsets(complete ? num_nodes + 1 : 0);
+  pvector<SGOffset> inv_offsets(complete && directed ? num_nodes + 1 : 0);
+  complete = complete && ReadCachedNeighbors(in, offsets, num_neighs, &neighs);
+  if (directed)
+    complete = complete && ReadCachedNeighbors(in, inv_offsets, num_neighs, &inv_neighs);
+  complete = complete && ReadCachedEdgeList(in, el);
+  if (!complete) {
+    std::cout << "[Cache] " << filename << " is truncated, rebuilding" << std::endl;
+    delete[] neighs;
+    delete[] inv_neighs;
+    return false;
+  }
+  WNode **index = WGraph::GenIndex(offsets, neighs);
+  if (!directed) {
+    *g = WGraph(num_nodes, index, neighs);
+  } else {
+    WNode **inv_index = WGraph::GenIndex(inv_offsets, inv_neighs);
+    *g = WGraph(num_nodes, index, neighs, inv_index, inv_neighs);
+  }
+  t.Stop();
+  PrintTime("Read Time", t.Seconds());
+  return true;
+}
+
+/*
+  Sampled pair list artifact: a list is stored as its length followed by
+  its EdgePairStruct entries
+*/
+void SavePairLists(
+  std::string filename,
+  std::vector<std::pair<EdgePairStruct*, long long int>> lists)
+{
+  std::ofstream out(filename, std::ios::out | std::ios::binary);
+  for (auto &l : lists) {
+    out.write(reinterpret_cast<char*>(&l.second), sizeof(l.second));
+    out.write(reinterpret_cast<char*>(l.first), l.second * sizeof(EdgePairStruct));
+  }
+}
+
+// False (a cache miss) if the artifact is truncated
+bool LoadPairLists(
+  std::string filename,
+  std::vector<std::pair<EdgePairStruct*, long long int>> lists)
+{
+  std::ifstream in(filename, std::ios::in | std::ios::binary);
+  for (auto &l : lists) {
+    long long int len = -1;
+    bool complete = ReadBytes(in, &len, sizeof(len));
+    if (complete && len != l.second) {
+      std::cout << "Cached pair list " << filename << " has " << len
+                << " pairs, expected " << l.second << std::endl;
+      std::exit(-53);
+    }
+    if (!complete || !ReadBytes(in, l.first, l.second * sizeof(EdgePairStruct))) {
+      std::cout << "[Cache] " << filename << " is truncated, resampling" << std::endl;
+      return false;
+    }
+  }
+  return true;
+}
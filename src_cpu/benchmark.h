@@ -28,7 +28,13 @@ Various helper functions to ease writing of kernels
 
 
 // Default type signatures for commonly used types
+// NODEID_32 (CMake option) halves the node IDs of the graph, the walks and
+// the pair lists; edge offsets (SGOffset) stay 64-bit
+#ifdef NODEID_32
+typedef int32_t NodeID;
+#else
 typedef int64_t NodeID;
+#endif
 typedef float WeightT;
 typedef NodeWeight<NodeID, WeightT> WNode;
 
@@ -68,23 +74,57 @@ class SourcePicker {
 };
 
 
+// Keeps the k pairs with largest values pushed so far in a min-heap,
+// so a push costs O(log k) instead of re-sorting the kept pairs
+template<typename KeyT, typename ValT>
+class TopKHeap {
+ public:
+  explicit TopKHeap(size_t k) : k_(k) {}
+
+  // Whether a pair with value val would be kept
+  bool Accepts(ValT val) const {
+    return (heap_.size() < k_) || ((k_ > 0) && (val > heap_.front().first));
+  }
+
+  void Push(KeyT key, ValT val) {
+    if (!Accepts(val))
+      return;
+    if (heap_.size() == k_) {
+      std::pop_heap(heap_.begin(), heap_.end(), Compare());
+      heap_.pop_back();
+    }
+    heap_.push_back(std::make_pair(val, key));
+    std::push_heap(heap_.begin(), heap_.end(), Compare());
+  }
+
+  void Merge(const TopKHeap &other) {
+    for (auto &vkp : other.heap_)
+      Push(vkp.second, vkp.first);
+  }
+
+  size_t size() const { return heap_.size(); }
+
+  // Kept pairs, largest value first
+  std::vector<std::pair<ValT, KeyT>> Sorted() const {
+    std::vector<std::pair<ValT, KeyT>> top_k(heap_);
+    std::sort(top_k.begin(), top_k.end(), Compare());
+    return top_k;
+  }
+
+ private:
+  typedef std::greater<std::pair<ValT, KeyT>> Compare;
+  size_t k_;
+  std::vector<std::pair<ValT, KeyT>> heap_;
+};
+
 // Returns k pairs with largest values from list of key-value pairs
 template<typename KeyT, typename ValT>
 std::vector<std::pair<ValT, KeyT>> TopK(
     const std::vector<std::pair<KeyT, ValT>> &to_sort, size_t k) {
-  std::vector<std::pair<ValT, KeyT>> top_k;
-  ValT min_so_far = 0;
-  for (auto kvp : to_sort) {
-    if ((top_k.size() < k) || (kvp.second > min_so_far)) {
-      top_k.push_back(std::make_pair(kvp.second, kvp.first));
-      std::sort(top_k.begin(), top_k.end(),
-                std::greater<std::pair<ValT, KeyT>>());
-      if (top_k.size() > k)
-        top_k.resize(k);
-      min_so_far = top_k.back().first;
-    }
-  }
-  return top_k;
+  TopKHeap<KeyT, ValT> top_k(k);
+  for (auto kvp : to_sort)
+    top_k.Push(kvp.first, kvp.second);
+  return top_k.Sorted();
 }
 
 
@@ -11,6 +11,10 @@
 #include <type_traits>
 #include <utility>
 
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
 #include "command_line.h"
 #include "generator.h"
 #include "graph.h"
@@ -45,6 +49,12 @@ class BuilderBase {
   bool needs_weights_;
   int64_t num_nodes_ = -1;
 
+  // Edgelist blocks and vertex ranges per thread of MakeCSR's histogram
+  static const int kBuildBlocksPerThread = 4;
+  static const int kBuildRangesPerThread = 16;
+  // Edges grouped per MakeCSR batch; bounds its buffer to 2 entries each
+  static const int kBuildBatchEdges = 1 << 24;
+
  public:
   explicit BuilderBase(const CLBase &cli) : cli_(cli) {
     symmetrize_ = cli_.symmetrize();
@@ -70,62 +80,20 @@ class BuilderBase {
     return max_seen;
   }
 
-  pvector<NodeID_> CountDegrees(const EdgeList &el, bool transpose) {
-    pvector<NodeID_> degrees(num_nodes_, 0);
-    #pragma omp parallel for
-    for (auto it = el.begin(); it < el.end(); it++) {
-      Edge e = *it;
-      if (symmetrize_ || (!symmetrize_ && !transpose))
-        fetch_and_add(degrees[e.u], 1);
-      if (symmetrize_ || (!symmetrize_ && transpose))
-        fetch_and_add(degrees[(NodeID_) e.v], 1);
-    }
-    return degrees;
-  }
-
-  static
-  pvector<SGOffset> PrefixSum(const pvector<NodeID_> &degrees) {
-    pvector<SGOffset> sums(degrees.size() + 1);
-    SGOffset total = 0;
-    for (size_t n=0; n < degrees.size(); n++) {
-      sums[n] = total;
-      total += degrees[n];
-    }
-    sums[degrees.size()] = total;
-    return sums;
+  // Calls f(node, neighbor) for every CSR entry that edge e contributes
+  template <typename F>
+  void ForEachEntry(Edge e, bool transpose, F f) {
+    if (symmetrize_ || (!symmetrize_ && !transpose))
+      f(e.u, e.v);
+    if (symmetrize_ || (!symmetrize_ && transpose))
+      f(static_cast<NodeID_>(e.v), GetSource(e));
   }
 
+  // Vertex offsets by a prefix sum over the degrees (ParallelScan)
   static
   pvector<SGOffset> ParallelPrefixSum(const pvector<NodeID_> &degrees) {
-    const size_t block_size = 1<<20;
-    const size_t num_blocks = (degrees.size() + block_size - 1) / block_size;
-    pvector<SGOffset> local_sums(num_blocks);
-    #pragma omp parallel for
-    for (size_t block=0; block < num_blocks; block++) {
-      SGOffset lsum = 0;
-      size_t block_end = std::min((block + 1) * block_size, degrees.size());
-      for (size_t i=block * block_size; i < block_end; i++)
-        lsum += degrees[i];
-      local_sums[block] = lsum;
-    }
-    pvector<SGOffset> bulk_prefix(num_blocks+1);
-    SGOffset total = 0;
-    for (size_t block=0; block < num_blocks; block++) {
-      bulk_prefix[block] = total;
-      total += local_sums[block];
-    }
-    bulk_prefix[num_blocks] = total;
     pvector<SGOffset> prefix(degrees.size() + 1);
-    #pragma omp parallel for
-    for (size_t block=0; block < num_blocks; block++) {
-      SGOffset local_total = bulk_prefix[block];
-      size_t block_end = std::min((block + 1) * block_size, degrees.size());
-      for (size_t i=block * block_size; i < block_end; i++) {
-        prefix[i] = local_total;
-        local_total += degrees[i];
-      }
-    }
-    prefix[degrees.size()] = bulk_prefix[num_blocks];
+    ParallelScan(degrees.data(), degrees.size(), prefix.data());
     return prefix;
   }
 
@@ -178,30 +146,206 @@ class BuilderBase {
     }
   }
 
+  // Temporal counterpart of SquishCSR for weighted (time-stamped) edges:
+  // every neighborhood is sorted by (neighbor, time) into a copy, equal
+  // (neighbor, time) pairs are collapsed if dedup, only the latest
+  // keep_last_k edges to every neighbor are kept if keep_last_k > 0, and
+  // the kept edges are sorted back into time order (SortByTime)
+  static
+  void SquishTemporalCSR(const CSRGraph<NodeID_, DestID_, invert> &g,
+                         bool transpose, bool dedup, int64_t keep_last_k,
+                         DestID_*** sq_index, DestID_** sq_neighs) {
+    pvector<SGOffset> full_offsets = g.VertexOffsets(transpose);
+    pvector<DestID_> squished(full_offsets[g.num_nodes()]);
+    pvector<NodeID_> diffs(g.num_nodes());
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (NodeID_ n=0; n < g.num_nodes(); n++) {
+      DestID_ *n_start = squished.data() + full_offsets[n];
+      DestID_ *n_end = n_start;
+      if (transpose) {
+        for (DestID_ v : g.in_neigh(n))
+          *n_end++ = v;
+      } else {
+        for (DestID_ v : g.out_neigh(n))
+          *n_end++ = v;
+      }
+      std::sort(n_start, n_end);
+      DestID_ *out = n_start;
+      for (DestID_ *run = n_start; run < n_end; ) {
+        DestID_ *kept = out;
+        DestID_ *it = run;
+        for (; it < n_end && it->v == run->v; it++)
+          if (!dedup || out == kept || (out - 1)->w != it->w)
+            *out++ = *it;
+        if (keep_last_k > 0 && out - kept > keep_last_k) {
+          std::copy(out - keep_last_k, out, kept);
+          out = kept + keep_last_k;
+        }
+        run = it;
+      }
+      SortByTime(n_start, out);
+      diffs[n] = out - n_start;
+    }
+    pvector<SGOffset> sq_offsets = ParallelPrefixSum(diffs);
+    *sq_neighs = new DestID_[sq_offsets[g.num_nodes()]];
+    *sq_index = CSRGraph<NodeID_, DestID_>::GenIndex(sq_offsets, *sq_neighs);
+    #pragma omp parallel for
+    for (NodeID_ n=0; n < g.num_nodes(); n++) {
+      DestID_ *n_start = squished.data() + full_offsets[n];
+      std::copy(n_start, n_start+diffs[n], (*sq_index)[n]);
+    }
+  }
+
+  // Shrinks a temporal graph before walking (SquishTemporalCSR); g is
+  // left unchanged
+  static
+  CSRGraph<NodeID_, DestID_, invert> SquishTemporalGraph(
+      const CSRGraph<NodeID_, DestID_, invert> &g, bool dedup,
+      int64_t keep_last_k) {
+    Timer t;
+    t.Start();
+    DestID_ **out_index, *out_neighs, **in_index = nullptr, *in_neighs = nullptr;
+    SquishTemporalCSR(g, false, dedup, keep_last_k, &out_index, &out_neighs);
+    if (g.directed() && invert)
+      SquishTemporalCSR(g, true, dedup, keep_last_k, &in_index, &in_neighs);
+    t.Stop();
+    PrintTime("Squish", t.Seconds());
+    CSRGraph<NodeID_, DestID_, invert> sq_g = g.directed() ?
+      CSRGraph<NodeID_, DestID_, invert>(g.num_nodes(), out_index, out_neighs,
+                                         in_index, in_neighs) :
+      CSRGraph<NodeID_, DestID_, invert>(g.num_nodes(), out_index, out_neighs);
+    std::cout << "Temporal squish kept " << sq_g.num_edges() << " of "
+              << g.num_edges() << " edges" << std::endl;
+    return sq_g;
+  }
+
+  // Groups the CSR entries of el[begin, end) by vertex range without
+  // atomics: split the edges into blocks and the vertices into ranges,
+  // count the entries of every block in every range (a blocks x ranges
+  // histogram), then scatter every block into its slots given by a prefix
+  // sum of the histogram. Range r ends up in
+  // grouped[range_start[r], range_start[r+1]) in edgelist order.
+  void GroupEntries(const EdgeList &el, int64_t begin, int64_t end,
+                    bool transpose, int64_t num_ranges, int64_t range_size,
+                    pvector<std::pair<NodeID_, DestID_>> &grouped,
+                    pvector<SGOffset> &range_start) {
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    const int64_t num_edges = end - begin;
+    const int64_t num_blocks = std::max<int64_t>(1,
+        std::min<int64_t>(num_edges, num_threads * kBuildBlocksPerThread));
+    const int64_t block_size = (num_edges + num_blocks - 1) / num_blocks;
+
+    // slots[b * num_ranges + r]: entries of block b in range r, then the
+    // position of the first of them in grouped
+    pvector<SGOffset> slots(num_blocks * num_ranges, 0);
+    #pragma omp parallel for schedule(static, 1)
+    for (int64_t b=0; b < num_blocks; b++) {
+      SGOffset *hist = slots.data() + b * num_ranges;
+      int64_t b_end = std::min(end, begin + (b + 1) * block_size);
+      for (int64_t i=begin + b * block_size; i < b_end; i++)
+        ForEachEntry(el[i], transpose, [&](NodeID_ u, DestID_) {
+          hist[u / range_size]++;
+        });
+    }
+    SGOffset total = 0;
+    for (int64_t r=0; r < num_ranges; r++) {
+      range_start[r] = total;
+      for (int64_t b=0; b < num_blocks; b++) {
+        SGOffset count = slots[b * num_ranges + r];
+        slots[b * num_ranges + r] = total;
+        total += count;
+      }
+    }
+    range_start[num_ranges] = total;
+    #pragma omp parallel for schedule(static, 1)
+    for (int64_t b=0; b < num_blocks; b++) {
+      SGOffset *slot = slots.data() + b * num_ranges;
+      int64_t b_end = std::min(end, begin + (b + 1) * block_size);
+      for (int64_t i=begin + b * block_size; i < b_end; i++)
+        ForEachEntry(el[i], transpose, [&](NodeID_ u, DestID_ v) {
+          grouped[slot[u / range_size]++] = std::make_pair(u, v);
+        });
+    }
+  }
+
   /*
   Graph Bulding Steps (for CSR):
-    - Read edgelist once to determine vertex degrees (CountDegrees)
-    - Determine vertex offsets by a prefix sum (ParallelPrefixSum)
+    - Walk the edgelist in batches of at most kBuildBatchEdges edges and
+      group each batch's entries by vertex range (GroupEntries)
+    - Determine vertex degrees one range per thread, then vertex offsets
+      by a prefix sum (ParallelPrefixSum)
     - Allocate storage and set points according to offsets (GenIndex)
-    - Copy edges into storage
+    - Group the batches again and copy their entries into storage one
+      range per thread
+  No atomics are needed, every neighborhood keeps edgelist order and the
+  grouping buffer stays bounded by the batch size rather than the edge
+  count.
   */
   void MakeCSR(const EdgeList &el, bool transpose, DestID_*** index,
                DestID_** neighs) {
-    pvector<NodeID_> degrees = CountDegrees(el, transpose);
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    const int64_t num_edges = el.size();
+    const int64_t batch_edges = std::max<int64_t>(1,
+        std::min<int64_t>(num_edges, kBuildBatchEdges));
+    const int64_t num_ranges = std::max<int64_t>(1,
+        std::min<int64_t>(num_nodes_, num_threads * kBuildRangesPerThread));
+    const int64_t range_size = (num_nodes_ + num_ranges - 1) / num_ranges;
+    // An edge adds at most two entries (both directions if symmetrizing)
+    pvector<std::pair<NodeID_, DestID_>> grouped(2 * batch_edges);
+    pvector<SGOffset> range_start(num_ranges + 1);
+
+    pvector<NodeID_> degrees(num_nodes_, 0);
+    for (int64_t begin=0; begin < num_edges; begin += batch_edges) {
+      GroupEntries(el, begin, std::min(num_edges, begin + batch_edges),
+                   transpose, num_ranges, range_size, grouped, range_start);
+      #pragma omp parallel for schedule(dynamic, 1)
+      for (int64_t r=0; r < num_ranges; r++)
+        for (SGOffset i=range_start[r]; i < range_start[r+1]; i++)
+          degrees[grouped[i].first]++;
+    }
     pvector<SGOffset> offsets = ParallelPrefixSum(degrees);
     *neighs = new DestID_[offsets[num_nodes_]];
     *index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, *neighs);
-    #pragma omp parallel for
-    for (auto it = el.begin(); it < el.end(); it++) {
-      Edge e = *it;
-      if (symmetrize_ || (!symmetrize_ && !transpose))
-        (*neighs)[fetch_and_add(offsets[e.u], 1)] = e.v;
-      if (symmetrize_ || (!symmetrize_ && transpose))
-        (*neighs)[fetch_and_add(offsets[static_cast<NodeID_>(e.v)], 1)] =
-            GetSource(e);
+    for (int64_t begin=0; begin < num_edges; begin += batch_edges) {
+      GroupEntries(el, begin, std::min(num_edges, begin + batch_edges),
+                   transpose, num_ranges, range_size, grouped, range_start);
+      #pragma omp parallel for schedule(dynamic, 1)
+      for (int64_t r=0; r < num_ranges; r++)
+        for (SGOffset i=range_start[r]; i < range_start[r+1]; i++)
+          (*neighs)[offsets[grouped[i].first]++] = grouped[i].second;
     }
   }
 
+  static bool EarlierEdge(NodeID_ a, NodeID_ b) {
+    return a < b;
+  }
+
+  static bool EarlierEdge(NodeWeight<NodeID_, WeightT_> a,
+                          NodeWeight<NodeID_, WeightT_> b) {
+    return a.w == b.w ? a.v < b.v : a.w < b.w;
+  }
+
+  // Sorts a neighborhood in place by increasing edge weight (time), then
+  // neighbor
+  static void SortByTime(DestID_ *n_start, DestID_ *n_end) {
+    std::sort(n_start, n_end, [](const DestID_ &a, const DestID_ &b) {
+      return EarlierEdge(a, b);
+    });
+  }
+
+  // Sorts all neighborhoods by time, in parallel
+  static void SortByTime(DestID_ **index, int64_t num_nodes) {
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (NodeID_ n=0; n < num_nodes; n++)
+      SortByTime(index[n], index[n+1]);
+  }
+
   CSRGraph<NodeID_, DestID_, invert> MakeGraphFromEL(EdgeList &el) {
     DestID_ **index = nullptr, **inv_index = nullptr;
     DestID_ *neighs = nullptr, *inv_neighs = nullptr;
@@ -214,6 +358,11 @@ class BuilderBase {
     MakeCSR(el, false, &index, &neighs);
     if (!symmetrize_ && invert)
       MakeCSR(el, true, &inv_index, &inv_neighs);
+    if (!std::is_same<NodeID_, DestID_>::value) {
+      SortByTime(index, num_nodes_);
+      if (!symmetrize_ && invert)
+        SortByTime(inv_index, num_nodes_);
+    }
     t.Stop();
     PrintTime("Build Time", t.Seconds());
     if (symmetrize_)
@@ -244,6 +393,35 @@ class BuilderBase {
     return g;
   }
 
+  // Same as MakeGraph, but appends the edges read from delta_filename
+  // (e.g., newly arrived temporal edges) before building; the appended
+  // edges are also returned in delta_el
+  CSRGraph<NodeID_, DestID_, invert> MakeGraphWithDelta(
+      EdgeList* el, EdgeList* delta_el, std::string delta_filename) {
+    if (cli_.filename() == "") {
+      std::cout << "Delta edges need a base graph file" << std::endl;
+      std::exit(-31);
+    }
+    Reader<NodeID_, DestID_, WeightT_, invert> r(cli_.filename());
+    if ((r.GetSuffix() == ".sg") || (r.GetSuffix() == ".wsg")) {
+      std::cout << "Cannot append delta edges to serialized graph"
+                << std::endl;
+      std::exit(-32);
+    }
+    *el = r.ReadFile(needs_weights_);
+    Reader<NodeID_, DestID_, WeightT_, invert> delta_r(delta_filename);
+    bool delta_needs_weights = needs_weights_;
+    *delta_el = delta_r.ReadFile(delta_needs_weights);
+    size_t base_size = el->size();
+    el->resize(base_size + delta_el->size());
+    #pragma omp parallel for
+    for (size_t e=0; e < delta_el->size(); e++)
+      (*el)[base_size + e] = (*delta_el)[e];
+    std::cout << "Appended " << delta_el->size() << " delta edges to "
+              << base_size << " base edges" << std::endl;
+    return MakeGraphFromEL(*el);
+  }
+
   // Relabels (and rebuilds) graph by order of decreasing degree
   static
   CSRGraph<NodeID_, DestID_, invert> RelabelByDegree(
@@ -281,6 +459,61 @@ class BuilderBase {
     PrintTime("Relabel", t.Seconds());
     return CSRGraph<NodeID_, DestID_, invert>(g.num_nodes(), index, neighs);
   }
+
+  static NodeID_ RelabelDest(NodeID_ v, const pvector<NodeID_> &new_ids) {
+    return new_ids[v];
+  }
+
+  static NodeWeight<NodeID_, WeightT_> RelabelDest(
+      NodeWeight<NodeID_, WeightT_> v, const pvector<NodeID_> &new_ids) {
+    return NodeWeight<NodeID_, WeightT_>(new_ids[v.v], v.w);
+  }
+
+  // Rebuilds one direction of g with node n renamed to new_ids[n]
+  static
+  void RelabelCSR(const CSRGraph<NodeID_, DestID_, invert> &g, bool transpose,
+                  const pvector<NodeID_> &new_ids, DestID_*** index,
+                  DestID_** neighs) {
+    pvector<NodeID_> degrees(g.num_nodes());
+    #pragma omp parallel for
+    for (NodeID_ n=0; n < g.num_nodes(); n++)
+      degrees[new_ids[n]] = transpose ? g.in_degree(n) : g.out_degree(n);
+    pvector<SGOffset> offsets = ParallelPrefixSum(degrees);
+    *neighs = new DestID_[offsets[g.num_nodes()]];
+    *index = CSRGraph<NodeID_, DestID_>::GenIndex(offsets, *neighs);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (NodeID_ u=0; u < g.num_nodes(); u++) {
+      DestID_ *out = (*index)[new_ids[u]];
+      if (transpose) {
+        for (DestID_ v : g.in_neigh(u))
+          *out++ = RelabelDest(v, new_ids);
+      } else {
+        for (DestID_ v : g.out_neigh(u))
+          *out++ = RelabelDest(v, new_ids);
+      }
+    }
+  }
+
+  // Relabels (and rebuilds) graph so that node n becomes new_ids[n];
+  // unlike RelabelByDegree, keeps directed graphs directed (with their
+  // inverse) and keeps edge weights (e.g., timestamps)
+  static
+  CSRGraph<NodeID_, DestID_, invert> RelabelByMapping(
+      const CSRGraph<NodeID_, DestID_, invert> &g,
+      const pvector<NodeID_> &new_ids) {
+    Timer t;
+    t.Start();
+    DestID_ **index, *neighs, **inv_index = nullptr, *inv_neighs = nullptr;
+    RelabelCSR(g, false, new_ids, &index, &neighs);
+    if (g.directed() && invert)
+      RelabelCSR(g, true, new_ids, &inv_index, &inv_neighs);
+    t.Stop();
+    PrintTime("Relabel", t.Seconds());
+    if (!g.directed())
+      return CSRGraph<NodeID_, DestID_, invert>(g.num_nodes(), index, neighs);
+    return CSRGraph<NodeID_, DestID_, invert>(g.num_nodes(), index, neighs,
+                                              inv_index, inv_neighs);
+  }
 };
 
 #endif  // BUILDER_H_
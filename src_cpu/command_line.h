@@ -130,10 +130,46 @@ class CLApp : public CLBase {
   int walk_length_ = 5;
   float target_val_accuracy_ = 0.75;
   int batch_size_ = 128;
+  std::string warm_start_file_name_ = "";
+  std::string checkpoint_file_name_ = "";
+  std::string delta_file_name_ = "";
+  std::string emb_out_file_name_ = "";
+  std::string emb_in_file_name_ = "";
+  std::string model_file_name_ = "";
+  int incremental_iter_ = 2;
+  std::string cache_dir_ = "";
+  int random_seed_ = -1;
+  int pipeline_overlap_ = 1;
+  int eval_batch_size_ = 65536;
+  int retrieve_k_ = 10;
+  int rerank_shortlist_ = 0;
+  int ann_nlist_ = 0;
+  int ann_nprobe_ = 8;
+  int ann_check_recall_ = 0;
+  int kmeans_clusters_ = 0;
+  int kmeans_iter_ = 20;
+  float kmeans_tol_ = 0.001;
+  std::string kmeans_file_ = "node_clusters.txt";
+  std::string neg_sampling_ = "uniform";
+  int neg_hard_pool_ = 20;
+  std::string walk_bias_ = "exponential";
+  std::string walk_start_time_ = "zero";
+  float walk_window_ = 0.5;
+  int64_t num_edge_walks_ = 0;
+  std::string edge_walk_bias_ = "uniform";
+  std::string walk_layout_ = "csr";
+  double csr_time_resolution_ = 1;
+  std::string walk_order_ = "none";
+  int dedup_edges_ = 0;
+  int64_t keep_last_k_ = 0;
+  std::string walk_time_window_ = "all";
+  float snapshot_span_ = 0;
+  int snapshot_train_blocks_ = 4;
+  int snapshot_test_blocks_ = 1;
 
  public:
   CLApp(int argc, char** argv, std::string name) : CLBase(argc, argv, name) {
-    get_args_ += "c:p:l:an:r:v";
+    get_args_ += "c:p:l:an:r:ve:o:w:b:m:x:";
     AddHelpLine('a', "", "output analysis of last run", "false");
     AddHelpLine('n', "n", "perform n trials", std::to_string(num_trials_));
     AddHelpLine('r', "node", "start from node r", "rand");
@@ -141,6 +177,24 @@ class CLApp : public CLBase {
     AddHelpLine('l', "", "maximum length of temporal walk", "5");
     AddHelpLine('p', "", "Labeled training file name for node classification", "add-graph-dir-name");
     AddHelpLine('c', "", "Script for configuring parameters");
+    AddHelpLine('o', "file", "save word2vec checkpoint to file");
+    AddHelpLine('w', "file", "warm-start word2vec from checkpoint file");
+    AddHelpLine('e', "file", "newly arrived edges (incremental mode, needs -w)");
+    AddHelpLine('b', "file", "save node embeddings to binary file");
+    AddHelpLine('m', "file", "mmap node embeddings from file, skip rwalk/word2vec");
+    AddHelpLine('x', "file", "trained link predictor (torch::save) file");
+  }
+
+  // Incremental mode continues a checkpoint, so -e is only valid with -w
+  bool ParseArgs() {
+    if (!CLBase::ParseArgs())
+      return false;
+    if ((delta_file_name_ != "") && (warm_start_file_name_ == "")) {
+      std::cout << "Newly arrived edges (-e) need a word2vec checkpoint (-w)."
+                << " (Use -h for help)" << std::endl;
+      return false;
+    }
+    return true;
   }
 
   void HandleArg(signed char opt, char* opt_arg) override {
@@ -151,6 +205,12 @@ class CLApp : public CLBase {
       case 'v': do_verify_ = true;                              break;
       case 'p': graph_dir_name_ = std::string(opt_arg);         break;
       case 'c': hyperparams_file_name_ = std::string(opt_arg);  break;
+      case 'o': checkpoint_file_name_ = std::string(opt_arg);   break;
+      case 'w': warm_start_file_name_ = std::string(opt_arg);   break;
+      case 'e': delta_file_name_ = std::string(opt_arg);        break;
+      case 'b': emb_out_file_name_ = std::string(opt_arg);      break;
+      case 'm': emb_in_file_name_ = std::string(opt_arg);       break;
+      case 'x': model_file_name_ = std::string(opt_arg);        break;
       default: CLBase::HandleArg(opt, opt_arg);
     }
   }
@@ -175,6 +235,43 @@ class CLApp : public CLBase {
   int get_max_walk_length() const { return walk_length_; }
   float get_target_val_accuracy() const { return target_val_accuracy_; }
   int get_batch_size() const { return batch_size_; }
+  std::string get_warm_start_file_name() const { return warm_start_file_name_; }
+  std::string get_checkpoint_file_name() const { return checkpoint_file_name_; }
+  std::string get_delta_file_name() const { return delta_file_name_; }
+  bool incremental() const { return warm_start_file_name_ != "" && delta_file_name_ != ""; }
+  int get_incremental_iter() const { return incremental_iter_; }
+  std::string get_cache_dir() const { return cache_dir_; }
+  int get_random_seed() const { return random_seed_; }
+  int get_pipeline_overlap() const { return pipeline_overlap_; }
+  int get_eval_batch_size() const { return eval_batch_size_; }
+  int get_retrieve_k() const { return retrieve_k_; }
+  int get_rerank_shortlist() const { return rerank_shortlist_; }
+  int get_ann_nlist() const { return ann_nlist_; }
+  int get_ann_nprobe() const { return ann_nprobe_; }
+  int get_ann_check_recall() const { return ann_check_recall_; }
+  int get_kmeans_clusters() const { return kmeans_clusters_; }
+  int get_kmeans_iter() const { return kmeans_iter_; }
+  float get_kmeans_tol() const { return kmeans_tol_; }
+  std::string get_kmeans_file() const { return kmeans_file_; }
+  std::string get_neg_sampling() const { return neg_sampling_; }
+  int get_neg_hard_pool() const { return neg_hard_pool_; }
+  std::string get_walk_bias() const { return walk_bias_; }
+  std::string get_walk_start_time() const { return walk_start_time_; }
+  float get_walk_window() const { return walk_window_; }
+  int64_t get_num_edge_walks() const { return num_edge_walks_; }
+  std::string get_edge_walk_bias() const { return edge_walk_bias_; }
+  std::string get_walk_layout() const { return walk_layout_; }
+  double get_csr_time_resolution() const { return csr_time_resolution_; }
+  std::string get_walk_order() const { return walk_order_; }
+  int get_dedup_edges() const { return dedup_edges_; }
+  int64_t get_keep_last_k() const { return keep_last_k_; }
+  std::string get_walk_time_window() const { return walk_time_window_; }
+  float get_snapshot_span() const { return snapshot_span_; }
+  int get_snapshot_train_blocks() const { return snapshot_train_blocks_; }
+  int get_snapshot_test_blocks() const { return snapshot_test_blocks_; }
+  std::string get_emb_out_file_name() const { return emb_out_file_name_; }
+  std::string get_emb_in_file_name() const { return emb_in_file_name_; }
+  std::string get_model_file_name() const { return model_file_name_; }
   std::string get_training_file_name()  const { 
     std::string file_base_path = "../data/node_class/";
     std::string file_name = "/train.tsv";
@@ -221,7 +318,37 @@ class CLApp : public CLBase {
                       walk_length_string = "walk_length",
                       target_val_accuracy_string = "target_validation_accuracy",
                       batch_size_string = "batch_size",
-                      num_workers_string = "num_workers";
+                      num_workers_string = "num_workers",
+                      incremental_iter_string = "incremental_iter",
+                      cache_dir_string = "cache_dir",
+                      random_seed_string = "random_seed",
+                      pipeline_overlap_string = "pipeline_overlap",
+                      eval_batch_size_string = "eval_batch_size",
+                      retrieve_k_string = "retrieve_k",
+                      rerank_shortlist_string = "rerank_shortlist",
+                      ann_nlist_string = "ann_nlist",
+                      ann_nprobe_string = "ann_nprobe",
+                      ann_check_recall_string = "ann_check_recall",
+                      kmeans_clusters_string = "kmeans_clusters",
+                      kmeans_iter_string = "kmeans_iter",
+                      kmeans_tol_string = "kmeans_tol",
+                      kmeans_file_string = "kmeans_file",
+                      neg_sampling_string = "neg_sampling",
+                      neg_hard_pool_string = "neg_hard_pool",
+                      walk_bias_string = "walk_bias",
+                      walk_start_time_string = "walk_start_time",
+                      walk_window_string = "walk_window",
+                      num_edge_walks_string = "num_edge_walks",
+                      edge_walk_bias_string = "edge_walk_bias",
+                      walk_layout_string = "walk_layout",
+                      csr_time_resolution_string = "csr_time_resolution",
+                      walk_order_string = "walk_order",
+                      dedup_edges_string = "dedup_edges",
+                      keep_last_k_string = "keep_last_k",
+                      walk_time_window_string = "walk_time_window",
+                      snapshot_span_string = "snapshot_span",
+                      snapshot_train_blocks_string = "snapshot_train_blocks",
+                      snapshot_test_blocks_string = "snapshot_test_blocks";
           if(in_line.find(out_dim_string) == 0)
           {
             std::istringstream splt(in_line);
@@ -350,6 +477,256 @@ class CLApp : public CLBase {
             };
             num_workers_ = std::stoi(split_string[1]);
           }
+          if(in_line.find(incremental_iter_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            incremental_iter_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(cache_dir_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            cache_dir_ = split_string[1];
+          }
+          if(in_line.find(random_seed_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            random_seed_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(pipeline_overlap_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            pipeline_overlap_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(eval_batch_size_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            eval_batch_size_ = std::stoi(split_string[1]);
+            if(eval_batch_size_ <= 0)
+            {
+              std::cout << "eval_batch_size has to be positive" << std::endl;
+              std::exit(-12);
+            }
+          }
+          if(in_line.find(retrieve_k_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            retrieve_k_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(rerank_shortlist_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            rerank_shortlist_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(ann_nlist_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            ann_nlist_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(ann_nprobe_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            ann_nprobe_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(ann_check_recall_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            ann_check_recall_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(kmeans_clusters_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            kmeans_clusters_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(kmeans_iter_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            kmeans_iter_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(kmeans_tol_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            kmeans_tol_ = std::stof(split_string[1]);
+          }
+          if(in_line.find(kmeans_file_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            kmeans_file_ = split_string[1];
+          }
+          if(in_line.find(neg_sampling_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            neg_sampling_ = split_string[1];
+          }
+          if(in_line.find(neg_hard_pool_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            neg_hard_pool_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(walk_bias_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            walk_bias_ = split_string[1];
+          }
+          if(in_line.find(walk_start_time_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            walk_start_time_ = split_string[1];
+          }
+          if(in_line.find(walk_window_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            walk_window_ = std::stof(split_string[1]);
+          }
+          if(in_line.find(num_edge_walks_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            num_edge_walks_ = std::stoll(split_string[1]);
+          }
+          if(in_line.find(edge_walk_bias_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            edge_walk_bias_ = split_string[1];
+          }
+          if(in_line.find(walk_layout_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            walk_layout_ = split_string[1];
+          }
+          if(in_line.find(csr_time_resolution_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            csr_time_resolution_ = std::stod(split_string[1]);
+            if(!(csr_time_resolution_ > 0))
+            {
+              std::cout << "csr_time_resolution has to be positive" << std::endl;
+              std::exit(-12);
+            }
+          }
+          if(in_line.find(walk_order_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            walk_order_ = split_string[1];
+          }
+          if(in_line.find(dedup_edges_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            dedup_edges_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(keep_last_k_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            keep_last_k_ = std::stoll(split_string[1]);
+          }
+          if(in_line.find(walk_time_window_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            walk_time_window_ = split_string[1];
+          }
+          if(in_line.find(snapshot_span_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            snapshot_span_ = std::stof(split_string[1]);
+          }
+          if(in_line.find(snapshot_train_blocks_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            snapshot_train_blocks_ = std::stoi(split_string[1]);
+          }
+          if(in_line.find(snapshot_test_blocks_string) == 0)
+          {
+            std::istringstream splt(in_line);
+            std::vector<std::string> split_string{
+              std::istream_iterator<std::string>(splt), {}
+            };
+            snapshot_test_blocks_ = std::stoi(split_string[1]);
+          }
 
         }
       }
@@ -407,6 +784,63 @@ class CLPageRank : public CLApp {
 
 
 
+class CLLinkScore : public CLApp {
+  std::string pairs_file_name_ = "";
+  std::string socket_path_ = "";
+  std::string query_file_name_ = "";
+  std::string scores_file_name_ = "link_scores.txt";
+
+ public:
+  CLLinkScore(int argc, char** argv, std::string name) :
+    CLApp(argc, argv, name) {
+    get_args_ += "i:d:q:t:";
+    AddHelpLine('i', "file", "candidate pairs <src dst> to score");
+    AddHelpLine('d', "path", "serve pairs over a Unix socket at path");
+    AddHelpLine('q', "file", "query nodes to retrieve top-K new links for");
+    AddHelpLine('t', "file", "write scores of -i/-q to file", scores_file_name_);
+  }
+
+  // Scoring needs no graph, only embeddings (-m), model (-x) and pairs;
+  // with -q a graph (-f) is optional and excludes existing links
+  bool ParseArgs() {
+    signed char c_opt;
+    extern char *optarg;          // from and for getopt
+    while ((c_opt = getopt(argc_, argv_, get_args_.c_str())) != -1) {
+      HandleArg(c_opt, optarg);
+    }
+    if ((get_emb_in_file_name() == "") || (get_model_file_name() == "")) {
+      std::cout << "Need embeddings (-m) and a model (-x). (Use -h for help)"
+                << std::endl;
+      return false;
+    }
+    int num_modes = (pairs_file_name_ != "") + (socket_path_ != "") +
+                    (query_file_name_ != "");
+    if (num_modes != 1) {
+      std::cout << "Need one of a pairs file (-i), a socket (-d) or query nodes (-q)."
+                << " (Use -h for help)" << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  void HandleArg(signed char opt, char* opt_arg) override {
+    switch (opt) {
+      case 'i': pairs_file_name_ = std::string(opt_arg);     break;
+      case 'd': socket_path_ = std::string(opt_arg);         break;
+      case 'q': query_file_name_ = std::string(opt_arg);     break;
+      case 't': scores_file_name_ = std::string(opt_arg);    break;
+      default: CLApp::HandleArg(opt, opt_arg);
+    }
+  }
+
+  std::string pairs_file_name() const { return pairs_file_name_; }
+  std::string socket_path() const { return socket_path_; }
+  std::string query_file_name() const { return query_file_name_; }
+  std::string scores_file_name() const { return scores_file_name_; }
+};
+
+
+
 template<typename WeightT_>
 class CLDelta : public CLApp {
   WeightT_ delta_ = 1;
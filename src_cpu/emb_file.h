@@ -0,0 +1,213 @@
+/*
+ * Binary node embedding file.
+ * Written after word2vec and loaded through mmap, so classifier runs over
+ * fixed embeddings can skip the rwalk and word2vec stages entirely.
+ *
+ * Layout (native endianness):
+ *   EmbFileHeader                  (64 bytes)
+ *   float   matrix[count * dim]    (at matrix_offset, row i = node ids[i])
+ *   int64_t ids[count]             (at index_offset, 8-byte aligned)
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+const char kEmbFileMagic[8] = {'R', 'W', 'E', 'M', 'B', '0', '0', '1'};
+
+struct EmbFileHeader {
+  char magic[8];
+  int64_t count;
+  int64_t dim;
+  int64_t matrix_offset;
+  int64_t index_offset;
+  int64_t reserved[3];
+};
+
+static_assert(sizeof(EmbFileHeader) == 64, "embedding file header must be 64 bytes");
+
+/*
+  Read-only view of a binary embedding file mapped into memory, or of a
+  copy of in-memory embeddings (rows in increasing NodeID order).
+  Rows are addressed either by position or, through RowOf(), by NodeID.
+*/
+class EmbeddingTable {
+ public:
+  explicit EmbeddingTable(std::string filename) {
+    int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) {
+      std::cout << "Couldn't open embedding file " << filename << std::endl;
+      std::exit(-43);
+    }
+    struct stat st;
+    fstat(fd, &st);
+    map_len_ = st.st_size;
+    if (map_len_ < sizeof(EmbFileHeader)) {
+      std::cout << filename << " is too small to be an embedding file" << std::endl;
+      std::exit(-44);
+    }
+    map_base_ = mmap(nullptr, map_len_, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (map_base_ == MAP_FAILED) {
+      std::cout << "Couldn't mmap embedding file " << filename << std::endl;
+      std::exit(-45);
+    }
+    const EmbFileHeader *header = static_cast<const EmbFileHeader*>(map_base_);
+    if (memcmp(header->magic, kEmbFileMagic, sizeof(kEmbFileMagic)) != 0) {
+      std::cout << filename << " is not an embedding file" << std::endl;
+      std::exit(-44);
+    }
+    count_ = header->count;
+    dim_ = header->dim;
+    int64_t matrix_offset = header->matrix_offset;
+    int64_t index_offset = header->index_offset;
+    // The matrix has to fit in front of the index; sizes are compared by
+    // division so that a corrupt header cannot overflow them
+    if (count_ < 0 || dim_ < 0 ||
+        matrix_offset < (int64_t) sizeof(EmbFileHeader) || matrix_offset % 4 != 0 ||
+        index_offset < matrix_offset || index_offset % 8 != 0 ||
+        (dim_ > 0 && count_ > (index_offset - matrix_offset) /
+                              (dim_ * (int64_t) sizeof(float)))) {
+      std::cout << filename << " is not an embedding file" << std::endl;
+      std::exit(-44);
+    }
+    if (index_offset > (int64_t) map_len_ ||
+        count_ > ((int64_t) map_len_ - index_offset) / (int64_t) sizeof(int64_t)) {
+      std::cout << "Embedding file " << filename << " is truncated" << std::endl;
+      std::exit(-44);
+    }
+    const char *base = static_cast<const char*>(map_base_);
+    matrix_ = reinterpret_cast<const float*>(base + matrix_offset);
+    ids_ = reinterpret_cast<const int64_t*>(base + index_offset);
+    int64_t max_id = -1;
+    for (int64_t i = 0; i < count_; i++) {
+      if (ids_[i] < 0 || ids_[i] > std::numeric_limits<NodeID>::max()) {
+        std::cout << filename << " is not an embedding file" << std::endl;
+        std::exit(-44);
+      }
+      max_id = std::max(max_id, ids_[i]);
+    }
+    row_of_.assign(max_id + 1, -1);
+    for (int64_t i = 0; i < count_; i++)
+      row_of_[ids_[i]] = i;
+  }
+
+  EmbeddingTable(const NodeEmb &node_emb, int64_t dim) {
+    count_ = node_emb.size();
+    dim_ = dim;
+    owned_matrix_.resize(count_ * dim_);
+    owned_ids_.resize(count_);
+    int64_t i = 0;
+    for (auto &kv : node_emb) {
+      if ((int64_t) kv.second.size() != dim_) {
+        std::cout << "Embedding of node " << kv.first << " has dim "
+                  << kv.second.size() << ", expected " << dim_ << std::endl;
+        std::exit(-42);
+      }
+      owned_ids_[i] = kv.first;
+      std::copy(kv.second.begin(), kv.second.begin() + dim_,
+                owned_matrix_.begin() + i * dim_);
+      i++;
+    }
+    matrix_ = owned_matrix_.data();
+    ids_ = owned_ids_.data();
+    row_of_.assign(count_ > 0 ? owned_ids_.back() + 1 : 0, -1);
+    for (i = 0; i < count_; i++)
+      row_of_[ids_[i]] = i;
+  }
+
+  ~EmbeddingTable() {
+    if (map_base_ != nullptr)
+      munmap(map_base_, map_len_);
+  }
+
+  EmbeddingTable(const EmbeddingTable&) = delete;
+  EmbeddingTable& operator=(const EmbeddingTable&) = delete;
+
+  int64_t count() const { return count_; }
+  int64_t dim() const { return dim_; }
+  const float* matrix() const { return matrix_; }
+  NodeID id(int64_t row) const { return ids_[row]; }
+  const float* row(int64_t r) const { return matrix_ + r * dim_; }
+
+  // Row holding the embedding of node n, -1 if n has none
+  int64_t RowOf(NodeID n) const {
+    if (n < 0 || n >= (NodeID) row_of_.size())
+      return -1;
+    return row_of_[n];
+  }
+
+  // Embedding of node n, which has to have one
+  const float* EmbeddingOf(NodeID n) const {
+    int64_t r = RowOf(n);
+    if (r < 0) {
+      std::cout << "Node " << n << " has no embedding" << std::endl;
+      std::exit(-46);
+    }
+    return row(r);
+  }
+
+ private:
+  void *map_base_ = nullptr;
+  size_t map_len_ = 0;
+  int64_t count_ = 0;
+  int64_t dim_ = 0;
+  const float *matrix_ = nullptr;
+  const int64_t *ids_ = nullptr;
+  std::vector<int64_t> row_of_;
+  std::vector<float> owned_matrix_;
+  std::vector<int64_t> owned_ids_;
+};
+
+/*
+  Writes the node embeddings to a binary embedding file; rows are stored
+  in the order of the table (increasing NodeID)
+*/
+void WriteEmbeddingFile(const EmbeddingTable &emb, std::string filename)
+{
+  Timer t;
+  t.Start();
+  EmbFileHeader header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, kEmbFileMagic, sizeof(header.magic));
+  header.count = emb.count();
+  header.dim = emb.dim();
+  header.matrix_offset = sizeof(EmbFileHeader);
+  int64_t matrix_bytes = header.count * header.dim * sizeof(float);
+  header.index_offset = (header.matrix_offset + matrix_bytes + 7) & ~((int64_t) 7);
+  std::ofstream out(filename, std::ios::out | std::ios::binary);
+  if (!out) {
+    std::cout << "Couldn't write embedding file " << filename << std::endl;
+    std::exit(-41);
+  }
+  out.write(reinterpret_cast<char*>(&header), sizeof(header));
+  out.write(reinterpret_cast<const char*>(emb.matrix()), matrix_bytes);
+  const char pad[8] = {0};
+  out.write(pad, header.index_offset - header.matrix_offset - matrix_bytes);
+  for (int64_t i = 0; i < emb.count(); i++) {
+    int64_t id = emb.id(i);
+    out.write(reinterpret_cast<char*>(&id), sizeof(id));
+  }
+  out.close();
+  t.Stop();
+  std::cout << "Wrote " << header.count << " x " << header.dim
+            << " embeddings to " << filename << std::endl;
+  PrintStep("[TimingStat] Embedding write time (s):", t.Seconds());
+}
+
+/*
+  Maps a binary embedding file; the rows are read in place by the
+  classifiers, k-means and the hard negative search
+*/
+EmbeddingTable* LoadEmbeddingFile(std::string filename)
+{
+  Timer t;
+  t.Start();
+  EmbeddingTable *table = new EmbeddingTable(filename);
+  t.Stop();
+  std::cout << "Loaded " << table->count() << " x " << table->dim()
+            << " embeddings from " << filename << std::endl;
+  PrintStep("[TimingStat] Embedding load time (s):", t.Seconds());
+  return table;
+}
@@ -0,0 +1,231 @@
+/*
+ * Spherical k-means over embedding rows.
+ * Serves word2vec "-classes", the coarse quantizer of the ANN index and
+ * the node clustering of the end-to-end benchmarks (kmeans_clusters).
+ * Centroids are seeded by k-means++; the assignment step multiplies a
+ * block of rows with a block of transposed centroids at a time (GEMM-style,
+ * so a centroid block stays in cache for many rows) and every thread
+ * accumulates the new centroids of its rows, which are then reduced.
+ */
+
+#include <limits>
+#include <random>
+
+const int64_t kKMeansRowBlock = 256;
+const int64_t kKMeansCentBlock = 64;
+
+/*
+  Clusters the n rows of data (row-major, n x dim) into k clusters by
+  cosine similarity. Stops after max_iter iterations or once at most a
+  fraction tol of the rows changed their cluster in an iteration.
+  On return assignment holds the cluster of every row and centroids the
+  k unit-length centroids (row-major, k x dim). Returns the number of
+  iterations run.
+*/
+int SphericalKMeans(
+  const float *data,
+  int64_t n,
+  int64_t dim,
+  int k,
+  int max_iter,
+  float tol,
+  unsigned seed,
+  std::vector<int> *assignment,
+  std::vector<float> *centroids)
+{
+  std::vector<int> &cl = *assignment;
+  std::vector<float> &cent = *centroids;
+  k = std::min<int64_t>(k, n);
+  cl.assign(n, 0);
+  cent.assign(k * dim, 0);
+  if (n == 0 || k <= 0)
+    return 0;
+
+  std::vector<float> inv_norm(n);
+  #pragma omp parallel for schedule(static)
+  for (int64_t r = 0; r < n; r++) {
+    const float *row = data + r * dim;
+    float sum = 0;
+    #pragma omp simd reduction(+:sum)
+    for (int64_t d = 0; d < dim; d++)
+      sum += row[d] * row[d];
+    inv_norm[r] = (sum > 0) ? 1.0f / std::sqrt(sum) : 0.0f;
+  }
+
+  // k-means++: every next centroid is a row drawn with probability
+  // proportional to its squared cosine distance to the closest centroid
+  std::mt19937 gen(seed);
+  std::vector<double> min_dist(n, std::numeric_limits<double>::max());
+  int64_t pick = std::uniform_int_distribution<int64_t>(0, n - 1)(gen);
+  for (int c = 0; c < k; c++) {
+    float *cv = cent.data() + c * dim;
+    for (int64_t d = 0; d < dim; d++)
+      cv[d] = data[pick * dim + d] * inv_norm[pick];
+    if (c == k - 1)
+      break;
+    double total = 0;
+    #pragma omp parallel for schedule(static) reduction(+:total)
+    for (int64_t r = 0; r < n; r++) {
+      const float *row = data + r * dim;
+      float dot = 0;
+      #pragma omp simd reduction(+:dot)
+      for (int64_t d = 0; d < dim; d++)
+        dot += cv[d] * row[d];
+      double dist = 1.0 - dot * inv_norm[r];
+      dist *= dist;
+      if (dist < min_dist[r])
+        min_dist[r] = dist;
+      total += min_dist[r];
+    }
+    if (total <= 0) {
+      // Fewer distinct directions than clusters
+      pick = std::uniform_int_distribution<int64_t>(0, n - 1)(gen);
+      continue;
+    }
+    double target = std::uniform_real_distribution<double>(0, total)(gen);
+    for (pick = 0; pick < n - 1; pick++) {
+      target -= min_dist[pick];
+      if (target <= 0)
+        break;
+    }
+  }
+
+  int num_threads = 1;
+#ifdef _OPENMP
+  num_threads = omp_get_max_threads();
+#endif
+  std::vector<std::vector<float>> thread_sums(num_threads);
+  std::vector<std::vector<int64_t>> thread_counts(num_threads);
+  std::vector<float> cent_t(dim * k);
+  int it = 0;
+  while (it < max_iter) {
+    it++;
+    int64_t changed = 0;
+    // Centroids transposed (dim x k) for the assignment step
+    #pragma omp parallel for schedule(static)
+    for (int64_t d = 0; d < dim; d++)
+      for (int c = 0; c < k; c++)
+        cent_t[d * k + c] = cent[c * dim + d];
+    // Threads that get no rows leave their sums empty
+    for (int t = 0; t < num_threads; t++) {
+      thread_sums[t].clear();
+      thread_counts[t].clear();
+    }
+    #pragma omp parallel reduction(+:changed)
+    {
+      int tid = 0;
+#ifdef _OPENMP
+      tid = omp_get_thread_num();
+#endif
+      std::vector<float> &sums = thread_sums[tid];
+      std::vector<int64_t> &counts = thread_counts[tid];
+      sums.assign(k * dim, 0);
+      counts.assign(k, 0);
+      std::vector<float> best_sim(kKMeansRowBlock);
+      std::vector<int> best_id(kKMeansRowBlock);
+      std::vector<float> sim(kKMeansCentBlock);
+
+      #pragma omp for schedule(dynamic, 4)
+      for (int64_t r_begin = 0; r_begin < n; r_begin += kKMeansRowBlock) {
+        int64_t r_len = std::min(kKMeansRowBlock, n - r_begin);
+        std::fill(best_sim.begin(), best_sim.end(), -std::numeric_limits<float>::max());
+        std::fill(best_id.begin(), best_id.end(), 0);
+        // sim[c] = row[r_begin + r] . centroid[c], one centroid block at a
+        // time; broadcasting row[d] over the transposed block vectorizes
+        // across centroids
+        for (int64_t c_begin = 0; c_begin < k; c_begin += kKMeansCentBlock) {
+          int64_t c_len = std::min<int64_t>(kKMeansCentBlock, k - c_begin);
+          for (int64_t r = 0; r < r_len; r++) {
+            const float *row = data + (r_begin + r) * dim;
+            std::fill(sim.begin(), sim.end(), 0.0f);
+            for (int64_t d = 0; d < dim; d++) {
+              float x = row[d];
+              const float *ct = cent_t.data() + d * k + c_begin;
+              #pragma omp simd
+              for (int64_t c = 0; c < c_len; c++)
+                sim[c] += x * ct[c];
+            }
+            for (int64_t c = 0; c < c_len; c++) {
+              if (sim[c] > best_sim[r]) {
+                best_sim[r] = sim[c];
+                best_id[r] = c_begin + c;
+              }
+            }
+          }
+        }
+        for (int64_t r = 0; r < r_len; r++) {
+          int64_t row_id = r_begin + r;
+          if (cl[row_id] != best_id[r] || it == 1)
+            changed++;
+          cl[row_id] = best_id[r];
+          const float *row = data + row_id * dim;
+          float *sum = sums.data() + best_id[r] * dim;
+          #pragma omp simd
+          for (int64_t d = 0; d < dim; d++)
+            sum[d] += row[d] * inv_norm[row_id];
+          counts[best_id[r]]++;
+        }
+      }
+    }
+
+    // Reduce the per-thread sums into normalized centroids;
+    // an empty cluster keeps its previous centroid
+    #pragma omp parallel for schedule(static)
+    for (int c = 0; c < k; c++) {
+      int64_t count = 0;
+      for (int t = 0; t < num_threads; t++)
+        count += thread_counts[t].empty() ? 0 : thread_counts[t][c];
+      if (count == 0)
+        continue;
+      float *cv = cent.data() + c * dim;
+      std::fill(cv, cv + dim, 0.0f);
+      for (int t = 0; t < num_threads; t++) {
+        if (thread_sums[t].empty())
+          continue;
+        const float *sum = thread_sums[t].data() + c * dim;
+        for (int64_t d = 0; d < dim; d++)
+          cv[d] += sum[d];
+      }
+      float norm = 0;
+      for (int64_t d = 0; d < dim; d++)
+        norm += cv[d] * cv[d];
+      norm = std::sqrt(norm);
+      if (norm > 0)
+        for (int64_t d = 0; d < dim; d++)
+          cv[d] /= norm;
+    }
+
+    if (it > 1 && changed <= tol * n)
+      break;
+  }
+  return it;
+}
+
+/*
+  Clusters the node embeddings into k clusters and writes one
+  "<node> <cluster>" line per node to out_file.
+*/
+void ClusterEmbeddings(
+  const EmbeddingTable &emb,
+  int k,
+  int max_iter,
+  float tol,
+  unsigned seed,
+  std::string out_file)
+{
+  Timer t;
+  t.Start();
+  int64_t n = emb.count();
+  std::vector<int> assignment;
+  std::vector<float> centroids;
+  int iters = SphericalKMeans(emb.matrix(), n, emb.dim(), k, max_iter, tol,
+                              seed, &assignment, &centroids);
+  t.Stop();
+
+  std::ofstream out(out_file);
+  for (int64_t i = 0; i < n; i++)
+    out << emb.id(i) << " " << assignment[i] << "\n";
+  std::cout << "Clustered " << n << " embeddings into " << k << " clusters in "
+            << iters << " iterations, wrote " << out_file << std::endl;
+  PrintStep("[TimingStat] K-means time (s):", t.Seconds());
+}
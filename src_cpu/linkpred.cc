@@ -7,6 +7,7 @@
 #include <pthread.h>
 #include <map>
 #include <fstream>
+#include <numeric>
 #include <experimental/algorithm>
 #include <torch/torch.h>
 
@@ -60,12 +61,21 @@ bool print_datasets = false;
 #define parallel_for for
 #endif
 
+#include "temporal_csr.h"
+#include "reorder.h"
 #include "rwalk.h"
+#include "emb_file.h"
+#include "kmeans.h"
 #include "word2vec.h"
+#include "topk_retrieval.h"
+#include "ann_index.h"
+#include "artifact_cache.h"
+#include "pipeline.h"
 #include "linkpred_datapreproc_opt.h"
 #include "linkpred_model.h"
 #include "linkpred_dataloader.h"
 #include "linkpred_classifier.h"
+#include "linkpred_snapshot.h"
 
 /*
   Link prediction on a temporal graph.
@@ -77,6 +87,25 @@ bool print_datasets = false;
   @ -c cofig-filename.txt
   @+ configuration file to set parameters
   @+ see example file - build/linkpred_params.txt
+
+  @ -o checkpoint-filename (optional)
+  @+ saves the trained word2vec model for later incremental runs
+
+  @ -w checkpoint-filename -e delta-filename.wel (optional)
+  @+ incremental mode: appends the newly arrived edges to the graph,
+  @+ only walks from the nodes they touch and continues training
+  @+ the checkpointed word2vec model for incremental_iter iterations
+
+  @ -x model-filename (optional)
+  @+ saves the trained classifier for the link-score binary
+
+  Setting cache_dir in the configuration file caches the CSR, the walk
+  corpus, the embeddings and the sampled pair lists, keyed on the input
+  file contents, the params each stage depends on and random_seed.
+  Later runs reuse every stage whose key is unchanged.
+
+  Setting snapshot_span evaluates sliding time windows of the graph
+  instead of a single train/test split (linkpred_snapshot.h).
 */
 
 int main(int argc, char* argv[]) {
@@ -86,27 +115,76 @@ int main(int argc, char* argv[]) {
   if (!cli.ParseArgs())
     return -1;
 
+  // Read parameter configuration file
+  cli.read_params_file();
+
+  if(cli.get_random_seed() >= 0) {
+    rng.seed(cli.get_random_seed());
+    srand(cli.get_random_seed());
+  }
+
+  // Stage artifacts are not cached when word2vec checkpoints are used,
+  // the graph and the model keep changing between those runs
+  bool use_checkpoints = cli.get_warm_start_file_name() != "" ||
+                         cli.get_checkpoint_file_name() != "";
+  ArtifactCache cache(use_checkpoints ? "" : cli.get_cache_dir());
+  std::string seed_param = KeyParam("seed", cli.get_random_seed() >= 0 ?
+    std::to_string(cli.get_random_seed()) : std::string("random"));
+
   // Data structures
   WeightedBuilder b(cli);
-  EdgeList el;
-  WGraph g = b.MakeGraph(&el);
+  EdgeList el, delta_el;
+  WGraph g;
+  std::string csr_key;
+  if(cache.enabled()) {
+    csr_key = StageKey("csr", HexKey(HashFile(cli.filename())),
+      {KeyParam("symmetrize", cli.symmetrize()),
+       KeyParam("nodeid_bytes", sizeof(NodeID)),
+       KeyParam("time_sorted", 1)});
+    if(!cache.Has("csr", csr_key) ||
+       !LoadGraphArtifact(cache.Path("csr", csr_key), &g, &el)) {
+      g = b.MakeGraph(&el);
+      SaveGraphArtifact(g, el, cache.TempPath("csr", csr_key));
+      cache.Commit("csr", csr_key);
+    }
+  } else {
+    g = cli.incremental() ?
+      b.MakeGraphWithDelta(&el, &delta_el, cli.get_delta_file_name()) :
+      b.MakeGraph(&el);
+  }
   NodeEmb node_emb;
+  std::unique_ptr<EmbeddingTable> emb;
 
-  // Read parameter configuration file
-  cli.read_params_file();
+  // The walks run on the temporal squish of g, the datasets on g and el
+  WGraph squished_g;
+  bool squish = cli.get_dedup_edges() || cli.get_keep_last_k() > 0;
+  if(squish)
+    squished_g = WeightedBuilder::SquishTemporalGraph(g, cli.get_dedup_edges(),
+                                                      cli.get_keep_last_k());
+  const WGraph &walk_g = squish ? squished_g : g;
 
   // Parameter initialization
   int   max_walk_length     =   cli.get_max_walk_length();
   float ratio               =   cli.get_training_ratio();
   int   node_embedding_dim  =   cli.get_node_emb_dim();
   int   num_walks_per_node  =   cli.get_num_walks_per_node();
+  WalkBias walk_bias        =   ParseWalkBias(cli.get_walk_bias());
+  WalkStart walk_start      =   MakeWalkStart(walk_g,
+    ParseWalkStartTime(cli.get_walk_start_time()), cli.get_walk_window());
+  int64_t num_edge_walks    =   cli.get_num_edge_walks();
+  EdgeStartBias edge_walk_bias = ParseEdgeStartBias(cli.get_edge_walk_bias());
+  WalkLayout walk_layout    =   ParseWalkLayout(cli.get_walk_layout());
+  NodeOrdering walk_order   =   ParseNodeOrdering(cli.get_walk_order());
   int   num_workers         =   cli.get_num_workers();
   int   output_dim          =   cli.get_output_dim();
   float learning_rate       =   cli.get_learning_rate();
   int   num_epochs          =   cli.get_num_epochs();
   int   hidden_layer_dim    =   cli.get_hidden_layer_dim();
   int   batch_size          =   cli.get_batch_size();
+  int   eval_batch_size     =   cli.get_eval_batch_size();
   float target_accuracy     =   cli.get_target_val_accuracy();
+  int   w2v_iter            =   cli.incremental() ? cli.get_incremental_iter() : 1;
+  NegSampling neg_sampling  =   ParseNegSampling(cli.get_neg_sampling());
 
   // Number of threads
   int num_threads;
@@ -120,13 +198,49 @@ int main(int argc, char* argv[]) {
   std::cout << "num_threads         : " << num_threads << std::endl;
   std::cout << "num_walks_per_node  : " << num_walks_per_node << std::endl;
   std::cout << "max_walk_length     : " << max_walk_length << std::endl;
+  std::cout << "walk_bias           : " << cli.get_walk_bias() << std::endl;
+  std::cout << "walk_start_time     : " << cli.get_walk_start_time() << std::endl;
+  std::cout << "num_edge_walks      : " << num_edge_walks << std::endl;
+  std::cout << "walk_layout         : " << cli.get_walk_layout() << std::endl;
+  std::cout << "walk_order          : " << cli.get_walk_order() << std::endl;
+  std::cout << "dedup_edges         : " << cli.get_dedup_edges() << std::endl;
+  std::cout << "keep_last_k         : " << cli.get_keep_last_k() << std::endl;
+  std::cout << "walk_time_window    : " << cli.get_walk_time_window() << std::endl;
+  std::cout << "snapshot_span       : " << cli.get_snapshot_span() << std::endl;
   std::cout << "node_embedding_dim  : " << node_embedding_dim << std::endl;
   std::cout << "num_workers         : " << num_workers << std::endl;
   std::cout << "learning_rate       : " << learning_rate << std::endl;
   std::cout << "num_epochs          : " << num_epochs << std::endl;
   std::cout << "hidden_layer_dim    : " << hidden_layer_dim << std::endl;
   std::cout << "batch_size          : " << batch_size << std::endl;
+  std::cout << "eval_batch_size     : " << eval_batch_size << std::endl;
   std::cout << "target_accuracy     : " << target_accuracy << std::endl;
+  std::cout << "incremental         : " << cli.incremental() << std::endl;
+  std::cout << "neg_sampling        : " << cli.get_neg_sampling() << std::endl;
+
+  // Params of the walk corpus, for the cache keys
+  std::vector<std::string> walk_params = {
+    KeyParam("walk_length", max_walk_length),
+    KeyParam("num_walks_per_node", num_walks_per_node),
+    KeyParam("walk_bias", cli.get_walk_bias()),
+    KeyParam("walk_start_time", cli.get_walk_start_time()),
+    KeyParam("walk_window", cli.get_walk_window()),
+    KeyParam("num_edge_walks", num_edge_walks),
+    KeyParam("edge_walk_bias", cli.get_edge_walk_bias()),
+    KeyParam("walk_layout", cli.get_walk_layout()),
+    KeyParam("csr_time_resolution", cli.get_csr_time_resolution()),
+    KeyParam("walk_order", cli.get_walk_order()),
+    KeyParam("dedup_edges", cli.get_dedup_edges()),
+    KeyParam("keep_last_k", cli.get_keep_last_k()), seed_param};
+
+  // Sliding-window snapshots instead of a single train/test split
+  if(cli.get_snapshot_span() > 0) {
+    std::cout << "snapshot_train_blocks : " << cli.get_snapshot_train_blocks() << std::endl;
+    std::cout << "snapshot_test_blocks  : " << cli.get_snapshot_test_blocks() << std::endl;
+    link_prediction_snapshots(cli, g, walk_g, el, cache, csr_key, walk_params,
+                              num_threads);
+    return 0;
+  }
 
   // Initialize arrays
   long long int test_dataset_size = g.num_edges() * (1 - ratio);
@@ -142,74 +256,253 @@ int main(int argc, char* argv[]) {
   EdgePairStruct* valid_p_list = new EdgePairStruct[valid_dataset_size];
   EdgePairStruct* valid_n_list = new EdgePairStruct[valid_dataset_size];
 
-  // Compute temporal random walk
-  std::cout << "\n---- RWALK ----\n";
-  compute_random_walk(
-    /* temporal graph */ g, 
-    /* max random walk length */ max_walk_length,
-    /* number of rwalks/node */ num_walks_per_node,
-    /* filename of random walk */ "out_random_walk.txt"
-  );
-
-  // Call word2vec function to create node embeddings
-  std::cout << "\n---- WORD2VEC ----\n";
-  custom_word2vec(
-    /* node embedding map */ &node_emb,
-    /* train_file */ "out_random_walk.txt",   // TODO: remove this
-    /* output_file */ "node_emb.txt",         // TODO: remove this
-    /* layer1_size */ node_embedding_dim,     // TODO: pass it from the command line
-    /* min_cnt */ 0,
-    /* window */ 10,
-    /* iter */ 1, 
-    /* cbow */ 0, // skip-gram model
-    /* num_threads */ num_threads,
-    /* print embedding to a file */ print_datasets
-  );
-
-  // Data pre-processing step to create dataset for the classifier
-  std::cout << "\n---- PREPROC ----\n";
-  link_prediction_data_preprocessing(
-    /* temporal graph */ g, 
-    /* edge list */ el,
-    /* temporal edge list */ temp_el,
-    /* positive samples for training */ train_p_list, 
-    /* negative samples for training */ train_n_list, 
-    /* positive samples for testing  */ test_p_list, 
-    /* negative samples for testing */ test_n_list,
-    /* positive samples for validation */ valid_p_list,
-    /* positive samples for validation */ valid_n_list,
-    // /* ratio of dataset division */ ratio       // TODO: pass it from the command line
-    /* num samples in training dataset */ train_dataset_size,
-    /* num samples in testing dataset */ test_dataset_size,
-    /* num samples in validation dataset */ valid_dataset_size
-  );
-  delete[] temp_el;
-
-  // Link prediction classifier that performs both training and testing
-  std::cout << "\n---- CLASSIFIER ----\n";
-  link_prediction_clasifier(
-    /* temporal graph */ g, 
-    /* positive samples for training */ train_p_list, 
-    /* negative samples for training */ train_n_list, 
-    /* positive samples for testing  */ test_p_list, 
-    /* nositive samples for testing */ test_n_list,
-    /* positive samples for validation  */ valid_p_list, 
-    /* nositive samples for validation */ valid_n_list,
-    /* node embeddings */ node_emb,
-    /* node embedding dimension */ node_embedding_dim,
-    // /* dataset size of training/testing */ train_test_dataset_size,
-    /* num samples in training dataset */ train_dataset_size,
-    /* num samples in testing dataset */ test_dataset_size,
-    /* num samples in validation dataset */ valid_dataset_size,
-    /* output dim of logistic regression */ output_dim,
-    /* learning rate */ learning_rate,
-    /* number of epochs for training */ num_epochs,
-    /* number of neurons in the hidden layer */ hidden_layer_dim,
-    /* batch_size */ batch_size,
-    /* target validation accuracy */ target_accuracy,
-    /* number of threads */ num_threads,
-    /* number of workers for parallel data loader */ num_workers
-  );
+  // The walks only see the edges in walk_time_window; "train" ends at the
+  // first test edge so that no test edge is walked
+  WeightT train_end = TrainWindowEnd(el, test_dataset_size);
+  TimeWindow walk_window = ParseTimeWindow(cli.get_walk_time_window(), &train_end);
+
+  // Threads of the concurrent stages: PREPROC runs next to RWALK and
+  // WORD2VEC unless it waits for the embeddings, KMEANS next to CLASSIFIER
+  bool overlap = cli.get_pipeline_overlap() == 1;
+  ThreadSplit walk_split(num_threads, overlap && neg_sampling != kNegHard);
+  ThreadSplit classifier_split(num_threads, overlap && cli.get_kmeans_clusters() > 0);
+
+  // Cache keys of the stages; decided up front so that
+  // the task graph below only contains stages that have work to do
+  std::string walk_file = "out_random_walk.txt";
+  std::string walk_key, emb_key, pairs_key;
+  bool emb_cached = false, walks_cached = false, pairs_cached = false;
+  if(cache.enabled()) {
+    std::vector<std::string> params = walk_params;
+    params.push_back(WindowKeyParam(walk_window));
+    walk_key = StageKey("walks", csr_key, params);
+    emb_key = StageKey("emb", walk_key, {
+      KeyParam("node_embedding_dim", node_embedding_dim),
+      KeyParam("precision", emb_precision), KeyParam("window", 10),
+      KeyParam("iter", w2v_iter), KeyParam("num_threads", walk_split.main)});
+    std::vector<std::string> pairs_params = {KeyParam("training_ratio", ratio),
+      KeyParam("neg_sampling", cli.get_neg_sampling()), seed_param};
+    if(neg_sampling == kNegHard) {
+      // Hard negatives also depend on the embeddings
+      pairs_params.push_back(KeyParam("emb", cli.get_emb_in_file_name() != "" ?
+        HexKey(HashFile(cli.get_emb_in_file_name())) : emb_key));
+      pairs_params.push_back(KeyParam("neg_hard_pool", cli.get_neg_hard_pool()));
+    }
+    pairs_key = StageKey("pairs", csr_key, pairs_params);
+    walk_file = cache.Path("walks", walk_key);
+    if(cli.get_emb_in_file_name() == "") {
+      emb_cached = cache.Has("emb", emb_key);
+      walks_cached = !emb_cached && cache.Has("walks", walk_key);
+    }
+    pairs_cached = cache.Has("pairs", pairs_key);
+  }
+  std::vector<std::pair<EdgePairStruct*, long long int>> pair_lists = {
+    {train_p_list, train_dataset_size}, {train_n_list, train_dataset_size},
+    {test_p_list, test_dataset_size}, {test_n_list, test_dataset_size},
+    {valid_p_list, valid_dataset_size}, {valid_n_list, valid_dataset_size}};
+
+  // Task graph: RWALK -> WORD2VEC -> CLASSIFIER, PREPROC -> CLASSIFIER;
+  // PREPROC does not need the embeddings and overlaps with the walks,
+  // unless neg_sampling is hard
+  TaskPipeline pipeline(overlap);
+  std::string emb_stage;
+  // Stages with random choices draw from their own generators, seeded
+  // here, since overlapped stages run concurrently
+  std::mt19937 walk_gen(rng()), preproc_gen(rng());
+
+  if(cli.get_emb_in_file_name() != "" || emb_cached) {
+    // Reuse embeddings of a previous run, skipping rwalk and word2vec
+    emb_stage = "EMBEDDINGS";
+    pipeline.AddStage(emb_stage, {}, [&]() {
+      std::cout << "\n---- EMBEDDINGS ----\n";
+      if(emb_cached) {
+        emb.reset(LoadEmbeddingFile(cache.Path("emb", emb_key)));
+      } else {
+        emb.reset(LoadEmbeddingFile(cli.get_emb_in_file_name()));
+        if(emb->dim() != node_embedding_dim) {
+          std::cout << "Using node_embedding_dim " << emb->dim()
+                    << " of the embedding file\n";
+          node_embedding_dim = emb->dim();
+        }
+      }
+      if(cli.get_emb_out_file_name() != "") {
+        WriteEmbeddingFile(*emb, cli.get_emb_out_file_name());
+        if(cli.get_ann_nlist() > 0)
+          BuildEmbeddingIndex(cli.get_emb_out_file_name(), cli.get_ann_nlist(), 10);
+      }
+    });
+  } else {
+    std::vector<std::string> w2v_deps;
+    if(walks_cached) {
+      std::cout << "Reusing random walks in " << walk_file << std::endl;
+    } else {
+      w2v_deps.push_back("RWALK");
+      pipeline.AddStage("RWALK", {}, [&]() {
+        // Compute temporal random walk
+        std::cout << "\n---- RWALK ----\n";
+        std::string walk_out = cache.enabled() ?
+          cache.TempPath("walks", walk_key) : walk_file;
+        if(cli.incremental()) {
+          std::vector<NodeID> delta_sources = FindDeltaWalkSources(walk_g, delta_el);
+          compute_random_walk_from_sources(
+            /* temporal graph */ walk_g, 
+            /* nodes touched by new edges */ delta_sources,
+            /* max random walk length */ max_walk_length,
+            /* number of rwalks/node */ num_walks_per_node,
+            /* filename of random walk */ walk_out,
+            /* temporal bias of the walks */ walk_bias,
+            /* initial time of the walks */ walk_start,
+            /* generator of the walks */ walk_gen,
+            /* time window of the walked edges */ walk_window
+          );
+        } else if(num_edge_walks > 0) {
+          compute_edge_walks(
+            /* temporal graph */ walk_g, 
+            /* max random walk length */ max_walk_length,
+            /* number of rwalks in total */ num_edge_walks,
+            /* filename of random walk */ walk_out,
+            /* temporal bias of the walks */ walk_bias,
+            /* bias of the initial edges */ edge_walk_bias,
+            /* generator of the walks */ walk_gen,
+            /* time window of the walked edges */ walk_window
+          );
+        } else {
+          compute_random_walk_on_layout(
+            /* temporal graph */ walk_g, 
+            /* graph layout of the walks */ walk_layout,
+            /* node ordering of the walks */ walk_order,
+            /* time quantum of the compressed layout */ cli.get_csr_time_resolution(),
+            /* max random walk length */ max_walk_length,
+            /* number of rwalks/node */ num_walks_per_node,
+            /* filename of random walk */ walk_out,
+            /* temporal bias of the walks */ walk_bias,
+            /* initial time of the walks */ walk_start,
+            /* generator of the walks */ walk_gen,
+            /* time window of the walked edges */ walk_window
+          );
+        }
+        if(cache.enabled())
+          cache.Commit("walks", walk_key);
+      }, walk_split.main);
+    }
+
+    emb_stage = "WORD2VEC";
+    pipeline.AddStage(emb_stage, w2v_deps, [&]() {
+      // Call word2vec function to create node embeddings
+      std::cout << "\n---- WORD2VEC ----\n";
+      custom_word2vec(
+        /* node embedding map */ &node_emb,
+        /* train_file */ walk_file,               // TODO: remove this
+        /* output_file */ "node_emb.txt",         // TODO: remove this
+        /* layer1_size */ node_embedding_dim,     // TODO: pass it from the command line
+        /* min_cnt */ 0,
+        /* window */ 10,
+        /* iter */ w2v_iter, 
+        /* cbow */ 0, // skip-gram model
+        /* num_threads */ walk_split.main,
+        /* print embedding to a file */ print_datasets,
+        /* checkpoint to warm-start from */ cli.get_warm_start_file_name(),
+        /* checkpoint to save */ cli.get_checkpoint_file_name()
+      );
+      // The later stages read the rows of one contiguous table
+      emb.reset(new EmbeddingTable(node_emb, node_embedding_dim));
+      NodeEmb().swap(node_emb);
+      if(cache.enabled()) {
+        WriteEmbeddingFile(*emb, cache.TempPath("emb", emb_key));
+        cache.Commit("emb", emb_key);
+      }
+      if(cli.get_emb_out_file_name() != "") {
+        WriteEmbeddingFile(*emb, cli.get_emb_out_file_name());
+        if(cli.get_ann_nlist() > 0)
+          BuildEmbeddingIndex(cli.get_emb_out_file_name(), cli.get_ann_nlist(), 10);
+      }
+    }, walk_split.main);
+  }
+
+  // Hard negatives are searched among the embeddings
+  std::vector<std::string> preproc_deps;
+  if(neg_sampling == kNegHard)
+    preproc_deps.push_back(emb_stage);
+  pipeline.AddStage("PREPROC", preproc_deps, [&]() {
+    // Data pre-processing step to create dataset for the classifier
+    std::cout << "\n---- PREPROC ----\n";
+    if(!pairs_cached || !LoadPairLists(cache.Path("pairs", pairs_key), pair_lists)) {
+      link_prediction_data_preprocessing(
+        /* temporal graph */ g, 
+        /* edge list */ el,
+        /* temporal edge list */ temp_el,
+        /* positive samples for training */ train_p_list, 
+        /* negative samples for training */ train_n_list, 
+        /* positive samples for testing  */ test_p_list, 
+        /* negative samples for testing */ test_n_list,
+        /* positive samples for validation */ valid_p_list,
+        /* positive samples for validation */ valid_n_list,
+        // /* ratio of dataset division */ ratio       // TODO: pass it from the command line
+        /* num samples in training dataset */ train_dataset_size,
+        /* num samples in testing dataset */ test_dataset_size,
+        /* num samples in validation dataset */ valid_dataset_size,
+        /* negative sampling strategy */ neg_sampling,
+        /* nearest non-neighbors per node for hard negatives */ cli.get_neg_hard_pool(),
+        /* node embeddings (hard negatives only) */
+        neg_sampling == kNegHard ? emb.get() : nullptr,
+        /* generator of the samples */ preproc_gen
+      );
+      if(cache.enabled()) {
+        SavePairLists(cache.TempPath("pairs", pairs_key), pair_lists);
+        cache.Commit("pairs", pairs_key);
+      }
+    }
+    delete[] temp_el;
+  }, emb_stage == "WORD2VEC" ? walk_split.side : num_threads);
+
+  pipeline.AddStage("CLASSIFIER", {emb_stage, "PREPROC"}, [&]() {
+    // Link prediction classifier that performs both training and testing
+    std::cout << "\n---- CLASSIFIER ----\n";
+    link_prediction_clasifier(
+      /* temporal graph */ g, 
+      /* positive samples for training */ train_p_list, 
+      /* negative samples for training */ train_n_list, 
+      /* positive samples for testing  */ test_p_list, 
+      /* nositive samples for testing */ test_n_list,
+      /* positive samples for validation  */ valid_p_list, 
+      /* nositive samples for validation */ valid_n_list,
+      /* node embeddings */ *emb,
+      /* node embedding dimension */ node_embedding_dim,
+      // /* dataset size of training/testing */ train_test_dataset_size,
+      /* num samples in training dataset */ train_dataset_size,
+      /* num samples in testing dataset */ test_dataset_size,
+      /* num samples in validation dataset */ valid_dataset_size,
+      /* output dim of logistic regression */ output_dim,
+      /* learning rate */ learning_rate,
+      /* number of epochs for training */ num_epochs,
+      /* number of neurons in the hidden layer */ hidden_layer_dim,
+      /* batch_size */ batch_size,
+      /* batch size of validation/testing */ eval_batch_size,
+      /* target validation accuracy */ target_accuracy,
+      /* number of threads */ classifier_split.main,
+      /* number of workers for parallel data loader */ num_workers,
+      /* file to save the trained model to */ cli.get_model_file_name()
+    );
+  }, classifier_split.main);
+
+  if(cli.get_kmeans_clusters() > 0) {
+    pipeline.AddStage("KMEANS", {emb_stage}, [&]() {
+      // Cluster the node embeddings next to the classifier
+      std::cout << "\n---- KMEANS ----\n";
+      ClusterEmbeddings(
+        /* node embeddings */ *emb,
+        /* number of clusters */ cli.get_kmeans_clusters(),
+        /* max iterations */ cli.get_kmeans_iter(),
+        /* fraction of changed assignments to stop at */ cli.get_kmeans_tol(),
+        /* seed of k-means++ */ cli.get_random_seed() >= 0 ?
+          (unsigned) cli.get_random_seed() : std::random_device{}(),
+        /* file of node clusters */ cli.get_kmeans_file()
+      );
+    }, classifier_split.side);
+  }
+
+  pipeline.Run();
+  pipeline.PrintTimings();
 
   // Clear memory
   // delete[] train_p_list;
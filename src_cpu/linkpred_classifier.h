@@ -2,7 +2,34 @@
  * Classifier module for link prediction that does both training and inference.
  */ 
 
-void link_prediction_clasifier(
+/*
+  Inference over a whole dataset: no autograd, a sequential sweep over the
+  contiguous feature tensor in eval_batch_size chunks, correct predictions
+  accumulated on the device and read back with a single sync at the end
+*/
+int64_t link_prediction_count_correct(
+    std::shared_ptr<Net> net,
+    const torch::Tensor &features,
+    const torch::Tensor &labels,
+    int64_t eval_batch_size)
+{
+    torch::NoGradGuard no_grad;
+    net->eval();
+    int64_t num_samples = features.size(0);
+    torch::Tensor correct = torch::zeros({}, torch::kLong);
+    for (int64_t begin = 0; begin < num_samples; begin += eval_batch_size) {
+        int64_t end = std::min(begin + eval_batch_size, num_samples);
+        auto output = net->forward(features.slice(0, begin, end).to(torch::kFloat));
+        correct += torch::round(output.view({-1})).eq(labels.slice(0, begin, end)).sum();
+    }
+    return correct.item<int64_t>();
+}
+
+/*
+  Trains the classifier on the training pairs (validating every 10
+  epochs) and returns its accuracy on the testing pairs
+*/
+float link_prediction_clasifier(
     const WGraph &g, 
     EdgePairStruct* train_p_list, 
     EdgePairStruct* train_n_list, 
@@ -10,7 +37,7 @@ void link_prediction_clasifier(
     EdgePairStruct* test_n_list,
     EdgePairStruct* valid_p_list,
     EdgePairStruct* valid_n_list,
-    NodeEmb node_emb,
+    const EmbeddingTable &emb,
     int node_embedding_dimension,
     long long int train_dataset_size,
     long long int test_dataset_size,
@@ -21,9 +48,11 @@ void link_prediction_clasifier(
     int num_epochs,
     int hidden_layer_dimension,
     int batch_size,
+    int eval_batch_size,
     float target_val_accuracy,
     int num_threads,
-    int num_workers)
+    int num_workers,
+    std::string model_out_file)
 {
     int input_size  = 2 * node_embedding_dimension;
 
@@ -33,7 +62,7 @@ void link_prediction_clasifier(
         g,
         train_p_list,
         train_n_list,
-        node_emb,
+        emb,
         node_embedding_dimension,
         train_dataset_size);
     auto training_custom_dataset = (*training_custom_ptr).map(torch::data::transforms::Stack<>());
@@ -44,23 +73,18 @@ void link_prediction_clasifier(
         std::move(training_custom_dataset), 
         torch::data::DataLoaderOptions().batch_size(batch_size).workers(num_workers));
 
-    // Custom data loader for validation set
+    // Validation set, evaluated without a data loader
     std::cout << "Loading validation dataset...\n";
     auto validation_custom_ptr = new CustomDataset(
         g,
         valid_p_list,
         valid_n_list,
-        node_emb,
+        emb,
         node_embedding_dimension,
         valid_dataset_size);
-    auto validation_custom_dataset = (*validation_custom_ptr).map(torch::data::transforms::Stack<>());
-    const size_t validation_data_size = validation_custom_dataset.size().value();
-    // const size_t validation_batch_size = validation_custom_dataset.size().value() / num_batches;
-    // Sampler types: SequentialSampler, RandomSampler
-    auto valid_data_loader = 
-        torch::data::make_data_loader<torch::data::samplers::RandomSampler>(
-        std::move(validation_custom_dataset), 
-        torch::data::DataLoaderOptions().batch_size(batch_size).workers(num_workers));
+    torch::Tensor valid_features = validation_custom_ptr->stacked_features();
+    torch::Tensor valid_labels = validation_custom_ptr->stacked_labels();
+    const size_t validation_data_size = valid_features.size(0);
 
     // Create a network
     auto net = std::make_shared<Net>
@@ -107,15 +131,8 @@ void link_prediction_clasifier(
         std::cout << "; training-loss: " << loss_acc / batch_index << std::endl;
         if(epoch % 10 == 0)
         {
-            net->eval();
-            int val_correct_samples = 0;
-            for (const auto& batch : *valid_data_loader) {
-                auto data = batch.data;
-                auto targets = batch.target.view({-1});
-                auto output = net->forward(data);
-                auto loss = torch::binary_cross_entropy(output, targets);
-                val_correct_samples += torch::sum(torch::eq(torch::round(output.view({-1})), targets)).item<int>(); 
-            }
+            int64_t val_correct_samples = link_prediction_count_correct(
+                net, valid_features, valid_labels, eval_batch_size);
             float val_accuracy = (float) val_correct_samples / validation_data_size;
             std::cout << "[Validation]     validation-accuracy: " << val_accuracy << std::endl;
             if(val_accuracy >= target_val_accuracy) {
@@ -131,52 +148,45 @@ void link_prediction_clasifier(
 
     std::cout << "Training finished!\n";
 
+    // Trained model for the link-score binary
+    if(model_out_file != "") {
+        torch::save(net, model_out_file);
+        std::cout << "Saved link predictor to " << model_out_file << std::endl;
+    }
+
     training_custom_ptr->clean_edge();
     validation_custom_ptr->clean_edge();
 
     /* Testing phase */
-    // Custom data loader for testing set
+    // Testing set, evaluated without a data loader
     std::cout << "Loading testing dataset...\n";
     auto testing_custom_ptr = new CustomDataset(
         g,
         test_p_list,
         test_n_list,
-        node_emb,
+        emb,
         node_embedding_dimension,
         test_dataset_size);
-    auto testing_custom_dataset = (*testing_custom_ptr).map(torch::data::transforms::Stack<>());
-    const size_t testing_data_size = testing_custom_dataset.size().value();
-    // Sampler types: SequentialSampler, RandomSampler
-    auto test_data_loader = 
-        torch::data::make_data_loader<torch::data::samplers::RandomSampler>(
-        std::move(testing_custom_dataset), 
-        torch::data::DataLoaderOptions().batch_size(batch_size).workers(num_workers));
+    torch::Tensor test_features = testing_custom_ptr->stacked_features();
+    torch::Tensor test_labels = testing_custom_ptr->stacked_labels();
+    const size_t testing_data_size = test_features.size(0);
 
     std::cout << "Testing...\n";
-    net->eval();
-
-    int num_correct = 0;
 
     Timer t_testing;
     t_testing.Start();
 
-    for (const auto& batch : *test_data_loader) {
-        auto data = batch.data;
-        auto targets = batch.target.view({-1});
-
-        auto output = net->forward(data);
-        
-        auto loss = torch::binary_cross_entropy(output, targets);
-        
-        num_correct += torch::sum(torch::eq(torch::round(output.view({-1})), targets)).item<int>();
-    }
+    int64_t num_correct = link_prediction_count_correct(
+        net, test_features, test_labels, eval_batch_size);
     
     t_testing.Stop();
     PrintStep("[TimingStat] Testing  time (s):", t_testing.Seconds());
 
     std::cout << "Total correct predictions: " << num_correct << std::endl;
 
-    std::cout << "Testing accuracy: " << (float)num_correct/testing_data_size << std::endl;
+    float test_accuracy = (float)num_correct/testing_data_size;
+    std::cout << "Testing accuracy: " << test_accuracy << std::endl;
 
     testing_custom_ptr->clean_edge();
+    return test_accuracy;
 }
\ No newline at end of file
@@ -2,6 +2,16 @@
  * Custom data loader module for link prediction.
  */
 
+// Edge features are stored at the word2vec embedding storage precision
+// (see emb_real in word2vec.h) and only widened to float in get()
+#if defined(EMB_BF16)
+const auto kEmbFeatureType = torch::kBFloat16;
+#elif defined(EMB_FP16)
+const auto kEmbFeatureType = torch::kHalf;
+#else
+const auto kEmbFeatureType = torch::kFloat;
+#endif
+
 template<typename T>
 void print_vector_of_pairs(std::vector<std::pair<T,T>> in_vec) 
 {
@@ -44,7 +54,7 @@ void print_tensor_array(torch::Tensor* t_array, int len)
 
 void compute_edge_features_labels(
     EdgePairStruct* edge_list,
-    NodeEmb node_emb,
+    const EmbeddingTable &emb,
     int node_embedding_dim,
     long long int train_test_dataset_size,
     std::vector<torch::Tensor>* edge_features,
@@ -53,15 +63,16 @@ void compute_edge_features_labels(
 )
 {
     int edge_emb_size = 2 * node_embedding_dim;
+    std::vector<float> edge_emb(edge_emb_size);
     for(long long int i=0; i<train_test_dataset_size; ++i)
     {
-        std::vector<float> src_emb, dst_emb;
-        src_emb =  node_emb.at(edge_list[i].src_node);
-        dst_emb =  node_emb.at(edge_list[i].dst_node);
+        const float *src_emb = emb.EmbeddingOf(edge_list[i].src_node);
+        const float *dst_emb = emb.EmbeddingOf(edge_list[i].dst_node);
         // Concatenate both source and destination embeddings...
-        src_emb.insert(src_emb.end(), dst_emb.begin(), dst_emb.end());
+        std::copy(src_emb, src_emb + node_embedding_dim, edge_emb.begin());
+        std::copy(dst_emb, dst_emb + node_embedding_dim, edge_emb.begin() + node_embedding_dim);
         torch::Tensor this_edge_emb = 
-            torch::from_blob(src_emb.data(), {edge_emb_size}).clone();
+            torch::from_blob(edge_emb.data(), {edge_emb_size}).clone();
         torch::Tensor this_edge_label = 
             torch::full({1}, label_val); //, torch::kLong);
         edge_features->push_back(this_edge_emb);
@@ -71,7 +82,7 @@ void compute_edge_features_labels(
 
 void compute_edge_features_labels_opt(
     EdgePairStruct* edge_list,
-    NodeEmb node_emb,
+    const EmbeddingTable &emb,
     int node_embedding_dim,
     long long int train_test_dataset_size,
     torch::Tensor* edge_features,
@@ -80,18 +91,20 @@ void compute_edge_features_labels_opt(
 )
 {
     int edge_emb_size = 2 * node_embedding_dim;
+    std::vector<float> edge_emb(edge_emb_size);
     for(long long int i=0; i<train_test_dataset_size; ++i)
     {
         long long int idx = i;
         if(label_val == 0)
             idx = train_test_dataset_size + i;
-        std::vector<float> src_emb, dst_emb;
-        src_emb =  node_emb.at(edge_list[i].src_node);
-        dst_emb =  node_emb.at(edge_list[i].dst_node);
+        const float *src_emb = emb.EmbeddingOf(edge_list[i].src_node);
+        const float *dst_emb = emb.EmbeddingOf(edge_list[i].dst_node);
         // Concatenate both source and destination embeddings...
-        src_emb.insert(src_emb.end(), dst_emb.begin(), dst_emb.end());
+        std::copy(src_emb, src_emb + node_embedding_dim, edge_emb.begin());
+        std::copy(dst_emb, dst_emb + node_embedding_dim, edge_emb.begin() + node_embedding_dim);
         torch::Tensor this_edge_emb = 
-            torch::from_blob(src_emb.data(), {edge_emb_size}).clone();
+            torch::from_blob(edge_emb.data(), {edge_emb_size})
+            .to(kEmbFeatureType, /*non_blocking=*/false, /*copy=*/true);
         torch::Tensor this_edge_label = 
             torch::full({1}, label_val); //, torch::kLong);
         edge_features[idx] = this_edge_emb;
@@ -104,7 +117,6 @@ class CustomDataset : public torch::data::Dataset<CustomDataset>
 private:
     EdgePairStruct* p_list;
     EdgePairStruct* n_list;
-    NodeEmb node_emb;
     int node_embedding_dim;
     long long int train_test_dataset_size;
     torch::Tensor* edge_features_priv;
@@ -130,13 +142,12 @@ public:
         const WGraph &g,
         EdgePairStruct* p_list_in,
         EdgePairStruct* n_list_in,
-        NodeEmb node_emb_in,
+        const EmbeddingTable &emb,
         int node_embedding_dim_in,
         long long int train_test_dataset_size_in
     )
     {
         ptr = this;
-        node_emb = node_emb_in;
         node_embedding_dim = node_embedding_dim_in;
         train_test_dataset_size = train_test_dataset_size_in;
 
@@ -151,7 +162,7 @@ public:
         std::cout << "Computing p_list edge features\n";
         compute_edge_features_labels_opt(
             p_list, 
-            node_emb, 
+            emb, 
             node_embedding_dim,
             train_test_dataset_size,
             edge_features_priv, 
@@ -162,7 +173,7 @@ public:
         std::cout << "Computing n_list edge features\n";
         compute_edge_features_labels_opt(
             n_list,
-            node_emb, 
+            emb, 
             node_embedding_dim,
             train_test_dataset_size,
             edge_features_priv, 
@@ -195,7 +206,21 @@ public:
     {
         torch::Tensor sample_node_id = edge_features_priv[index];
         torch::Tensor sample_label   = edge_labels_priv[index];
-        return {sample_node_id.clone(), sample_label.clone()};
+        return {sample_node_id.to(torch::kFloat, /*non_blocking=*/false, /*copy=*/true),
+                sample_label.clone()};
+    };
+
+    // Whole dataset as one contiguous [2 * size, 2 * dim] feature tensor
+    // (kept at the storage precision) and a [2 * size] label tensor,
+    // for the sequential inference sweep that bypasses the data loader
+    torch::Tensor stacked_features() const
+    {
+        return torch::stack(torch::TensorList(edge_features_priv, 2 * train_test_dataset_size));
+    };
+
+    torch::Tensor stacked_labels() const
+    {
+        return torch::cat(torch::TensorList(edge_labels_priv, 2 * train_test_dataset_size));
     };
 
     // Return the length of data
@@ -1,24 +1,101 @@
 /*
  * Optimized data pre-processing for link prediction.
  * Applied optimized data structures and parallelism in negative_sampling().
+ * Negatives are drawn by one of the NegSampling strategies.
  */
 
+// Negative sampling strategies (neg_sampling in the params file)
+enum NegSampling
+{
+    kNegUniform,     // corrupt tail or both ends with uniform node IDs
+    kNegDegree,      // corrupt tail with a node drawn proportional to out-degree
+    kNegHistorical,  // test negatives are earlier edges absent from the test window
+    kNegHard         // corrupt tail with a nearest non-neighbor in embedding space
+};
+
+NegSampling ParseNegSampling(std::string name)
+{
+    if(name == "uniform") return kNegUniform;
+    if(name == "degree") return kNegDegree;
+    if(name == "historical") return kNegHistorical;
+    if(name == "hard") return kNegHard;
+    std::cout << "Unknown neg_sampling " << name
+              << " (uniform, degree, historical, hard)" << std::endl;
+    std::exit(-91);
+}
+
+// Every chunk of samples draws from its own generator, seeded from the
+// generator of the preprocessing stage, so the samples do not depend on
+// the number of threads
+const long long int kNegChunk = 1024;
+// Draws of a biased sampler before falling back to a uniform corruption
+const int kNegMaxTries = 64;
+
+/*
+  Vose's alias table: draws index i with probability weights[i] / sum
+  in O(1) after an O(n) build
+*/
+class AliasTable
+{
+ public:
+    void Build(const std::vector<double> &weights)
+    {
+        int64_t n = weights.size();
+        double sum = std::accumulate(weights.begin(), weights.end(), 0.0);
+        prob_.assign(n, 1.0);
+        alias_.resize(n);
+        std::iota(alias_.begin(), alias_.end(), 0);
+        if(sum <= 0)
+            return;
+        std::vector<int64_t> small, large;
+        std::vector<double> scaled(n);
+        for(int64_t i=0; i<n; ++i)
+        {
+            scaled[i] = weights[i] * n / sum;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+        while(!small.empty() && !large.empty())
+        {
+            int64_t s = small.back(), l = large.back();
+            small.pop_back();
+            prob_[s] = scaled[s];
+            alias_[s] = l;
+            scaled[l] -= 1.0 - scaled[s];
+            if(scaled[l] < 1.0)
+            {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+    }
+
+    int64_t Sample(std::mt19937 &gen) const
+    {
+        int64_t i = std::uniform_int_distribution<int64_t>(0, prob_.size()-1)(gen);
+        return std::uniform_real_distribution<double>(0, 1)(gen) < prob_[i] ? i : alias_[i];
+    }
+
+    bool empty() const { return prob_.empty(); }
+
+ private:
+    std::vector<double> prob_;
+    std::vector<int64_t> alias_;
+};
+
 void corrupt_tail(
     const WGraph &g, 
     EdgePairStruct* n_list,
     EdgePairStruct edge_in,
     long long int i,
-    int64_t num_nodes)
+    int64_t num_nodes,
+    std::mt19937 &gen)
 {
+    std::uniform_int_distribution<NodeID> uid(0,num_nodes-1);
     while(1)
     {
-        static std::uniform_int_distribution<NodeID> uid(0,num_nodes-1);
-        NodeID new_dst = uid(rng);
+        NodeID new_dst = uid(gen);
         if(!g.EdgeExists(edge_in.src_node, new_dst))
         {
-            if((new_dst > num_nodes-1) || (new_dst < 0)) {
-                std::cout << "wrong node_id 2\n";
-            }
             n_list[i].src_node = edge_in.src_node;
             n_list[i].dst_node = new_dst;
             break;
@@ -31,20 +108,16 @@ void corrupt_both(
     EdgePairStruct* n_list,
     EdgePairStruct edge_in,
     long long int i,
-    int64_t num_nodes)
+    int64_t num_nodes,
+    std::mt19937 &gen)
 {
+    std::uniform_int_distribution<NodeID> uid(0,num_nodes-1);
     while(1)
     {
-        static std::uniform_int_distribution<NodeID> uid1(0,num_nodes-1);
-        static std::uniform_int_distribution<NodeID> uid2(0,num_nodes-1);
-        NodeID new_src = uid1(rng);
-        NodeID new_dst = uid2(rng);
+        NodeID new_src = uid(gen);
+        NodeID new_dst = uid(gen);
         if(!g.EdgeExists(new_src, new_dst))
         {
-            if((new_src < 0) || (new_dst < 0) 
-                || (new_src > num_nodes-1) || (new_dst > num_nodes-1)) {
-                std::cout << "wrong node_id 1/2\n";
-            }
             n_list[i].src_node = new_src;
             n_list[i].dst_node = new_dst;
             break;
@@ -52,24 +125,145 @@ void corrupt_both(
     }
 }
 
-void negative_sampling(
+/*
+  Shared state of the negative sampling strategies, built once
+  before the pair lists are sampled
+*/
+struct NegSampler
+{
+    NegSampling strategy = kNegUniform;
+    // kNegDegree: nodes weighted by out-degree
+    AliasTable degree_table;
+    // kNegHistorical: edges before the test window that are not in it
+    std::vector<EdgePairStruct> historical;
+    // kNegHard: sorted source nodes and their nearest non-neighbors
+    std::vector<NodeID> hard_src;
+    std::vector<LinkCandidates> hard_dst;
+};
+
+void build_degree_sampler(const WGraph &g, NegSampler &sampler)
+{
+    std::vector<double> weights(g.num_nodes());
+    parallel_for(NodeID n=0; n<g.num_nodes(); ++n)
+        weights[n] = g.out_degree(n);
+    sampler.degree_table.Build(weights);
+}
+
+void build_historical_sampler(
+    TempELStruct* temp_el,
+    long long int edge_cnt,
+    long long int test_dataset_size,
+    NegSampler &sampler)
+{
+    long long int window_begin = edge_cnt - test_dataset_size;
+    std::vector<std::pair<NodeID, NodeID>> window;
+    for(long long int i=window_begin; i<edge_cnt; ++i)
+        window.push_back({temp_el[i].src_node, temp_el[i].dst_node});
+    std::sort(window.begin(), window.end());
+    for(long long int i=0; i<window_begin; ++i)
+    {
+        std::pair<NodeID, NodeID> e(temp_el[i].src_node, temp_el[i].dst_node);
+        if(!std::binary_search(window.begin(), window.end(), e))
+            sampler.historical.push_back({e.first, e.second});
+    }
+    std::cout << sampler.historical.size()
+              << " historical edges are not repeated in the test window\n";
+}
+
+void build_hard_sampler(
     const WGraph &g,
-    EdgePairStruct* p_list,
+    const EmbeddingTable &emb,
+    int hard_pool,
+    const std::vector<std::pair<EdgePairStruct*, long long int>> &p_lists,
+    NegSampler &sampler)
+{
+    for(auto &pl : p_lists)
+        for(long long int i=0; i<pl.second; ++i)
+            sampler.hard_src.push_back(pl.first[i].src_node);
+    std::sort(sampler.hard_src.begin(), sampler.hard_src.end());
+    sampler.hard_src.erase(
+        std::unique(sampler.hard_src.begin(), sampler.hard_src.end()),
+        sampler.hard_src.end());
+    sampler.hard_dst = RetrieveTopK(emb, sampler.hard_src, hard_pool, &g);
+}
+
+void sample_negative(
+    const WGraph &g,
+    const NegSampler &sampler,
+    NegSampling strategy,
     EdgePairStruct* n_list,
-    long long int test_train_data_size,
-    int64_t num_nodes)
+    EdgePairStruct edge_in,
+    long long int i,
+    std::mt19937 &gen)
 {
-    // EdgePairStruct* n_list = new EdgePairStruct[test_train_data_size];
-    parallel_for(long long int i=0; i<test_train_data_size; ++i)
+    switch(strategy)
     {
-        static std::uniform_real_distribution<double> uid(0,1); 
-        if(uid(rng) > 0.5)
+    case kNegDegree:
+        for(int t=0; t<kNegMaxTries; ++t)
         {
-            corrupt_tail(g, n_list, p_list[i], i, g.num_nodes());
-        } else
+            NodeID new_dst = sampler.degree_table.Sample(gen);
+            if(!g.EdgeExists(edge_in.src_node, new_dst))
+            {
+                n_list[i].src_node = edge_in.src_node;
+                n_list[i].dst_node = new_dst;
+                return;
+            }
+        }
+        break;
+    case kNegHistorical:
+        if(!sampler.historical.empty())
         {
-            corrupt_both(g, n_list, p_list[i], i, g.num_nodes());
+            n_list[i] = sampler.historical[std::uniform_int_distribution<size_t>(
+                0, sampler.historical.size()-1)(gen)];
+            return;
         }
+        break;
+    case kNegHard:
+    {
+        auto it = std::lower_bound(sampler.hard_src.begin(), sampler.hard_src.end(),
+                                   edge_in.src_node);
+        const LinkCandidates &pool = sampler.hard_dst[it - sampler.hard_src.begin()];
+        if(!pool.empty())
+        {
+            n_list[i].src_node = edge_in.src_node;
+            n_list[i].dst_node = pool[std::uniform_int_distribution<size_t>(
+                0, pool.size()-1)(gen)].second;
+            return;
+        }
+        break;
+    }
+    default:
+        break;
+    }
+    // Uniform corruption, also the fallback of the biased strategies
+    if(std::uniform_real_distribution<double>(0, 1)(gen) > 0.5)
+    {
+        corrupt_tail(g, n_list, edge_in, i, g.num_nodes(), gen);
+    } else
+    {
+        corrupt_both(g, n_list, edge_in, i, g.num_nodes(), gen);
+    }
+}
+
+void negative_sampling(
+    const WGraph &g,
+    EdgePairStruct* p_list,
+    EdgePairStruct* n_list,
+    long long int test_train_data_size,
+    const NegSampler &sampler,
+    NegSampling strategy,
+    std::mt19937 &stage_gen)
+{
+    uint64_t base_seed = stage_gen();
+    long long int num_chunks = (test_train_data_size + kNegChunk - 1) / kNegChunk;
+    #pragma omp parallel for schedule(dynamic)
+    for(long long int c=0; c<num_chunks; ++c)
+    {
+        std::seed_seq seq{base_seed, (uint64_t) c};
+        std::mt19937 gen(seq);
+        long long int end = std::min(test_train_data_size, (c+1) * kNegChunk);
+        for(long long int i=c*kNegChunk; i<end; ++i)
+            sample_negative(g, sampler, strategy, n_list, p_list[i], i, gen);
     }
 }
 
@@ -96,7 +290,8 @@ void print_temp_el(TempELStruct* temp_el, int edge_cnt)
 {
     for(int i=0; i<edge_cnt; ++i)
     {
-        printf("{%ld, %ld, %f}\n", temp_el[i].src_node, temp_el[i].dst_node, temp_el[i].time_stamp);
+        printf("{%" PRId64 ", %" PRId64 ", %f}\n", (int64_t) temp_el[i].src_node,
+               (int64_t) temp_el[i].dst_node, temp_el[i].time_stamp);
     }
 }
 
@@ -104,7 +299,8 @@ void print_edge_pair(EdgePairStruct* edge_pair, int edge_cnt)
 {
     for(int i=0; i<edge_cnt; ++i)
     {
-        printf("{%ld, %ld}\n", edge_pair[i].src_node, edge_pair[i].dst_node);
+        printf("{%" PRId64 ", %" PRId64 "}\n", (int64_t) edge_pair[i].src_node,
+               (int64_t) edge_pair[i].dst_node);
     }
 }
 
@@ -113,28 +309,33 @@ bool SortStructByTime(TempELStruct tmp1, TempELStruct tmp2)
   return (tmp1.time_stamp < tmp2.time_stamp);
 }
 
+/*
+  Time of the first test edge: link_prediction_data_preprocessing tests on
+  the test_dataset_size latest edges of el, so the training edges are the
+  ones before it (walk_time_window train)
+*/
+WeightT TrainWindowEnd(const EdgeList &el, long long int test_dataset_size)
+{
+  if(test_dataset_size <= 0 || el.size() == 0)
+    return std::numeric_limits<WeightT>::max();
+  std::vector<WeightT> times(el.size());
+  #pragma omp parallel for
+  for(size_t e=0; e<el.size(); ++e)
+    times[e] = el[e].v.w;
+  auto first_test = times.begin() + (el.size() - test_dataset_size);
+  std::nth_element(times.begin(), first_test, times.end());
+  return *first_test;
+}
 
-void link_prediction_data_preprocessing
-(
-    const WGraph &g, 
+
+/*
+  Copies el into temp_el and sorts it by time; returns the number of edges
+*/
+long long int sort_temporal_edges(
+    const WGraph &g,
     EdgeList &el,
-    TempELStruct* temp_el,
-    EdgePairStruct* train_p_list,
-    EdgePairStruct* train_n_list,
-    EdgePairStruct* test_p_list,
-    EdgePairStruct* test_n_list,
-    EdgePairStruct* valid_p_list,
-    EdgePairStruct* valid_n_list,
-    // float ratio
-    long long int train_dataset_size,
-    long long int test_dataset_size,
-    long long int valid_dataset_size
-)
+    TempELStruct* temp_el)
 {
-    std::cout << "Preprocessing data...\n";
-
-    Timer t_data_preproc;
-    t_data_preproc.Start();
     long long int edge_cnt = 0;
     for(size_t e=0; e<el.size(); ++e)
     {
@@ -146,14 +347,46 @@ void link_prediction_data_preprocessing
     
     // Sort the edge list according to time stamps
     std::sort(temp_el, (temp_el+(g.num_edges())), SortStructByTime);
+    return edge_cnt;
+}
+
+/*
+  Samples the datasets of one split of the time-sorted temp_el: the
+  training and validation positives are drawn from the edges
+  [train_begin, test_begin), the testing positives are the edges
+  [test_begin, test_end). emb is only read by hard negative sampling
+  and may be null otherwise
+*/
+void link_prediction_window_preprocessing
+(
+    const WGraph &g, 
+    TempELStruct* temp_el,
+    long long int train_begin,
+    long long int test_begin,
+    long long int test_end,
+    EdgePairStruct* train_p_list,
+    EdgePairStruct* train_n_list,
+    EdgePairStruct* test_p_list,
+    EdgePairStruct* test_n_list,
+    EdgePairStruct* valid_p_list,
+    EdgePairStruct* valid_n_list,
+    long long int train_dataset_size,
+    long long int valid_dataset_size,
+    NegSampling neg_sampling,
+    int hard_pool,
+    const EmbeddingTable *emb,
+    std::mt19937 &gen
+)
+{
+    long long int test_dataset_size = test_end - test_begin;
 
     // Separate training and testing edge sets
-    // long long int test_train_data_size = g.num_edges() * (1 - ratio);
-    EdgePairStruct* potential_train_p_list = new EdgePairStruct[edge_cnt - test_dataset_size];
+    long long int potential_train_size = test_begin - train_begin;
+    EdgePairStruct* potential_train_p_list = new EdgePairStruct[potential_train_size];
     long long int train_cnt = 0, test_cnt = 0;
-    for(long long int i=0; i<edge_cnt; ++i)
+    for(long long int i=train_begin; i<test_end; ++i)
     {
-        if(i < (edge_cnt - test_dataset_size))
+        if(i < test_begin)
         {
             potential_train_p_list[train_cnt].src_node = temp_el[i].src_node;
             potential_train_p_list[train_cnt].dst_node = temp_el[i].dst_node;
@@ -170,20 +403,20 @@ void link_prediction_data_preprocessing
     std::experimental::sample
     (
         potential_train_p_list, 
-        potential_train_p_list + (edge_cnt - test_dataset_size),
+        potential_train_p_list + potential_train_size,
         train_p_list,
         train_dataset_size,
-        std::mt19937{std::random_device{}()}
+        std::mt19937{gen()}
     );
 
     // Sample validation set
     std::experimental::sample
     (
         potential_train_p_list,
-        potential_train_p_list + (edge_cnt - test_dataset_size),
+        potential_train_p_list + potential_train_size,
         valid_p_list,
         valid_dataset_size,
-        std::mt19937{std::random_device{}()}
+        std::mt19937{gen()}
     );
 
     delete[] potential_train_p_list;
@@ -191,16 +424,28 @@ void link_prediction_data_preprocessing
     std::cout << "Negative sampling...\n";
     Timer t_neg_sampl;
     t_neg_sampl.Start();
-    
-    negative_sampling(g, train_p_list, train_n_list, train_dataset_size, g.num_nodes());
-    negative_sampling(g, valid_p_list, valid_n_list, valid_dataset_size, g.num_nodes());
-    negative_sampling(g, test_p_list,  test_n_list,  test_dataset_size,  g.num_nodes());
+
+    NegSampler sampler;
+    if(neg_sampling == kNegDegree)
+        build_degree_sampler(g, sampler);
+    else if(neg_sampling == kNegHistorical)
+        build_historical_sampler(temp_el + train_begin, test_end - train_begin,
+                                 test_dataset_size, sampler);
+    else if(neg_sampling == kNegHard)
+        build_hard_sampler(g, *emb, hard_pool,
+            {{train_p_list, train_dataset_size}, {valid_p_list, valid_dataset_size},
+             {test_p_list, test_dataset_size}}, sampler);
+
+    // Historical negatives only exist relative to the test window;
+    // the training and validation negatives stay uniform
+    NegSampling train_sampling =
+        (neg_sampling == kNegHistorical) ? kNegUniform : neg_sampling;
+    negative_sampling(g, train_p_list, train_n_list, train_dataset_size, sampler, train_sampling, gen);
+    negative_sampling(g, valid_p_list, valid_n_list, valid_dataset_size, sampler, train_sampling, gen);
+    negative_sampling(g, test_p_list,  test_n_list,  test_dataset_size,  sampler, neg_sampling, gen);
     
     t_neg_sampl.Stop();
-    t_data_preproc.Stop();
-
     PrintStep("[TimingStat] Negative sampling time     (s):", t_neg_sampl.Seconds());
-    PrintStep("[TimingStat] Data pre-preprocssing time (s):", t_data_preproc.Seconds());
 
     // Print datasets for debugging?
     // CAUTION: This will print the entire training/testing datasets
@@ -217,4 +462,41 @@ void link_prediction_data_preprocessing
         print_edge_pair(test_n_list, test_dataset_size);
     }
     
-}
\ No newline at end of file
+}
+
+void link_prediction_data_preprocessing
+(
+    const WGraph &g, 
+    EdgeList &el,
+    TempELStruct* temp_el,
+    EdgePairStruct* train_p_list,
+    EdgePairStruct* train_n_list,
+    EdgePairStruct* test_p_list,
+    EdgePairStruct* test_n_list,
+    EdgePairStruct* valid_p_list,
+    EdgePairStruct* valid_n_list,
+    // float ratio
+    long long int train_dataset_size,
+    long long int test_dataset_size,
+    long long int valid_dataset_size,
+    NegSampling neg_sampling,
+    int hard_pool,
+    const EmbeddingTable *emb,
+    std::mt19937 &gen
+)
+{
+    std::cout << "Preprocessing data...\n";
+
+    Timer t_data_preproc;
+    t_data_preproc.Start();
+    long long int edge_cnt = sort_temporal_edges(g, el, temp_el);
+
+    // The latest test_dataset_size edges are tested on
+    link_prediction_window_preprocessing(
+        g, temp_el, 0, edge_cnt - test_dataset_size, edge_cnt,
+        train_p_list, train_n_list, test_p_list, test_n_list,
+        valid_p_list, valid_n_list, train_dataset_size, valid_dataset_size,
+        neg_sampling, hard_pool, emb, gen);
+    t_data_preproc.Stop();
+    PrintStep("[TimingStat] Data pre-preprocssing time (s):", t_data_preproc.Seconds());
+}
@@ -0,0 +1,280 @@
+/*
+ * Sliding-window snapshots for link prediction (snapshot_span > 0).
+ * The graph is loaded and its edges are sorted by time once. The time
+ * range is cut into blocks of snapshot_span starting at the earliest edge;
+ * window w trains on blocks [w, w + snapshot_train_blocks) and tests on
+ * the next snapshot_test_blocks blocks, then the windows slide by one
+ * block (e.g. train on weeks 1-4, test on week 5, slide by a week).
+ *
+ * The walks of a block run on a time-window view of the CSR and never
+ * cross the block's boundaries, so every block is walked once and its
+ * walks are reused by all the windows that train on it; the corpus of a
+ * window is the concatenation of its blocks' walks. With cache_dir set
+ * the block walks and the window embeddings are cached across runs too.
+ * Every window samples its datasets from the time-sorted edge list,
+ * trains its own word2vec model and classifier, and its accuracy and
+ * stage times are reported at the end.
+ */
+
+// Cache key param of a time window
+std::string WindowKeyParam(const TimeWindow &window)
+{
+  return KeyParam("walk_time_window", std::to_string(window.start) + "," +
+                                      std::to_string(window.end));
+}
+
+struct SnapshotResult {
+  TimeWindow train;
+  TimeWindow test;
+  long long int train_edges = 0;
+  long long int test_edges = 0;
+  float accuracy = 0;
+  double walk_time = 0;
+  double emb_time = 0;
+  double preproc_time = 0;
+  double classifier_time = 0;
+};
+
+void link_prediction_snapshots(
+  const CLApp &cli,
+  const WGraph &g,
+  const WGraph &walk_g,
+  EdgeList &el,
+  ArtifactCache &cache,
+  std::string csr_key,
+  const std::vector<std::string> &walk_params,
+  int num_threads)
+{
+  WeightT span = cli.get_snapshot_span();
+  int train_blocks = cli.get_snapshot_train_blocks();
+  int test_blocks = cli.get_snapshot_test_blocks();
+  if(cli.incremental() || cli.get_emb_in_file_name() != "") {
+    std::cout << "snapshot_span does not combine with incremental runs "
+              << "or input embeddings" << std::endl;
+    std::exit(-99);
+  }
+
+  Timer t_total;
+  t_total.Start();
+  std::vector<TempELStruct> temp_el(g.num_edges());
+  long long int edge_cnt = sort_temporal_edges(g, el, temp_el.data());
+  WeightT t_min = edge_cnt > 0 ? temp_el[0].time_stamp : 0;
+  WeightT t_max = edge_cnt > 0 ? temp_el[edge_cnt - 1].time_stamp : 0;
+  int64_t num_blocks = (int64_t) ((t_max - t_min) / span) + 1;
+  int64_t num_windows = num_blocks - train_blocks - test_blocks + 1;
+  if(edge_cnt == 0 || train_blocks < 1 || test_blocks < 1 || num_windows < 1) {
+    std::cout << "Need snapshot_train_blocks + snapshot_test_blocks <= "
+              << num_blocks << " blocks of snapshot_span " << span
+              << " (both at least 1)" << std::endl;
+    std::exit(-99);
+  }
+  std::cout << "Snapshots: " << num_windows << " windows over " << num_blocks
+            << " blocks of " << span << " from time " << t_min << std::endl;
+
+  auto block_start = [&](int64_t b) { return (WeightT) (t_min + (double) b * span); };
+  // First edge at or after time t
+  auto edge_index = [&](WeightT t) {
+    return std::lower_bound(temp_el.begin(), temp_el.begin() + edge_cnt, t,
+      [](const TempELStruct &e, WeightT time) { return e.time_stamp < time; })
+      - temp_el.begin();
+  };
+
+  int max_walk_length = cli.get_max_walk_length();
+  int node_embedding_dim = cli.get_node_emb_dim();
+  WalkBias walk_bias = ParseWalkBias(cli.get_walk_bias());
+  WalkStartTime walk_start_time = ParseWalkStartTime(cli.get_walk_start_time());
+  EdgeStartBias edge_walk_bias = ParseEdgeStartBias(cli.get_edge_walk_bias());
+  WalkLayout walk_layout = ParseWalkLayout(cli.get_walk_layout());
+  NodeOrdering walk_order = ParseNodeOrdering(cli.get_walk_order());
+  NegSampling neg_sampling = ParseNegSampling(cli.get_neg_sampling());
+  // PREPROC runs next to RWALK and WORD2VEC unless it needs the embeddings
+  ThreadSplit walk_split(num_threads,
+    cli.get_pipeline_overlap() == 1 && neg_sampling != kNegHard);
+
+  // With walk_order the graph is relabeled once, on the first walked
+  // block, and every block walks its window of the relabeled graph
+  NodeOrder node_order;
+  WGraph ordered_g;
+  bool ordered = false;
+
+  // Walks of every block, computed on first use
+  std::vector<std::string> block_files(num_blocks);
+  auto walk_block = [&](int64_t b, std::mt19937 &gen) {
+    if(block_files[b] != "")
+      return;
+    TimeWindow block;
+    block.start = block_start(b);
+    block.end = block_start(b + 1);
+    std::string key, walk_out;
+    if(cache.enabled()) {
+      std::vector<std::string> params = walk_params;
+      params.push_back(WindowKeyParam(block));
+      key = StageKey("walks", csr_key, params);
+      block_files[b] = cache.Path("walks", key);
+      if(cache.Has("walks", key))
+        return;
+      walk_out = cache.TempPath("walks", key);
+    } else {
+      block_files[b] = walk_out = "out_random_walk_block" + std::to_string(b) + ".txt";
+    }
+    if(cli.get_num_edge_walks() > 0) {
+      compute_edge_walks(walk_g, max_walk_length, cli.get_num_edge_walks(),
+                         walk_out, walk_bias, edge_walk_bias, gen, block);
+    } else {
+      WalkStart walk_start;
+      walk_start.strategy = walk_start_time;
+      walk_start.window_start = block.end - cli.get_walk_window() * span;
+      if(walk_order != kOrderNone && !ordered) {
+        node_order = MakeNodeOrder(walk_g, walk_order);
+        ordered_g = RelabelForWalks(walk_g, node_order);
+        ordered = true;
+      }
+      compute_random_walk_on_layout(ordered ? ordered_g : walk_g,
+                                    ordered ? &node_order : nullptr, walk_layout,
+                                    cli.get_csr_time_resolution(), max_walk_length,
+                                    cli.get_num_walks_per_node(), walk_out,
+                                    walk_bias, walk_start, gen, block);
+    }
+    if(cache.enabled())
+      cache.Commit("walks", key);
+  };
+
+  // Uncached block walks are removed once no later window trains on them
+  auto drop_block = [&](int64_t b) {
+    if(!cache.enabled() && block_files[b] != "")
+      std::remove(block_files[b].c_str());
+  };
+
+  std::vector<SnapshotResult> results;
+  for(int64_t w = 0; w < num_windows; ++w) {
+    SnapshotResult r;
+    r.train.start = block_start(w);
+    r.train.end = r.test.start = block_start(w + train_blocks);
+    r.test.end = block_start(w + train_blocks + test_blocks);
+    long long int train_begin = edge_index(r.train.start);
+    long long int test_begin = edge_index(r.test.start);
+    long long int test_end = edge_index(r.test.end);
+    r.train_edges = test_begin - train_begin;
+    r.test_edges = test_end - test_begin;
+    std::cout << "\n---- SNAPSHOT " << w + 1 << "/" << num_windows << " ----\n";
+    std::cout << "Training on [" << r.train.start << ", " << r.train.end << ") ("
+              << r.train_edges << " edges), testing on [" << r.test.start << ", "
+              << r.test.end << ") (" << r.test_edges << " edges)" << std::endl;
+    if(r.train_edges == 0 || r.test_edges == 0) {
+      std::cout << "Skipping the window, it has no training or testing edges\n";
+      drop_block(w);
+      continue;
+    }
+
+    // As in the full run: three training and one validation pair per test pair
+    long long int test_dataset_size = r.test_edges;
+    long long int train_dataset_size = std::min(3 * test_dataset_size, r.train_edges);
+    long long int valid_dataset_size = std::min(test_dataset_size, r.train_edges);
+    std::vector<EdgePairStruct> train_p(train_dataset_size), train_n(train_dataset_size);
+    std::vector<EdgePairStruct> test_p(test_dataset_size), test_n(test_dataset_size);
+    std::vector<EdgePairStruct> valid_p(valid_dataset_size), valid_n(valid_dataset_size);
+
+    std::string emb_key;
+    bool emb_cached = false;
+    if(cache.enabled()) {
+      std::vector<std::string> params = walk_params;
+      params.push_back(KeyParam("snapshot_span", span));
+      params.push_back(WindowKeyParam(r.train));
+      emb_key = StageKey("emb", StageKey("walks", csr_key, params), {
+        KeyParam("node_embedding_dim", node_embedding_dim),
+        KeyParam("precision", emb_precision), KeyParam("window", 10),
+        KeyParam("iter", 1), KeyParam("num_threads", walk_split.main)});
+      emb_cached = cache.Has("emb", emb_key);
+    }
+
+    NodeEmb node_emb;
+    std::unique_ptr<EmbeddingTable> emb;
+    std::string walk_file = "out_random_walk.txt";
+    TaskPipeline pipeline(cli.get_pipeline_overlap() == 1);
+    // RWALK and PREPROC may overlap, so each has its own generator
+    std::mt19937 walk_gen(rng()), preproc_gen(rng());
+    std::string emb_stage = emb_cached ? "EMBEDDINGS" : "WORD2VEC";
+    if(emb_cached) {
+      pipeline.AddStage(emb_stage, {}, [&]() {
+        emb.reset(LoadEmbeddingFile(cache.Path("emb", emb_key)));
+      });
+    } else {
+      pipeline.AddStage("RWALK", {}, [&]() {
+        std::cout << "\n---- RWALK ----\n";
+        std::ofstream corpus(walk_file, std::ios::out | std::ios::binary);
+        for(int64_t b = w; b < w + train_blocks; ++b) {
+          walk_block(b, walk_gen);
+          std::ifstream in(block_files[b], std::ios::in | std::ios::binary);
+          corpus << in.rdbuf();
+        }
+      }, walk_split.main);
+      pipeline.AddStage(emb_stage, {"RWALK"}, [&]() {
+        std::cout << "\n---- WORD2VEC ----\n";
+        custom_word2vec(&node_emb, walk_file, "node_emb.txt", node_embedding_dim,
+                        0, 10, 1, 0, walk_split.main, print_datasets);
+        emb.reset(new EmbeddingTable(node_emb, node_embedding_dim));
+        NodeEmb().swap(node_emb);
+        if(cache.enabled()) {
+          WriteEmbeddingFile(*emb, cache.TempPath("emb", emb_key));
+          cache.Commit("emb", emb_key);
+        }
+      }, walk_split.main);
+    }
+
+    std::vector<std::string> preproc_deps;
+    if(neg_sampling == kNegHard)
+      preproc_deps.push_back(emb_stage);
+    pipeline.AddStage("PREPROC", preproc_deps, [&]() {
+      std::cout << "\n---- PREPROC ----\n";
+      link_prediction_window_preprocessing(
+        g, temp_el.data(), train_begin, test_begin, test_end,
+        train_p.data(), train_n.data(), test_p.data(), test_n.data(),
+        valid_p.data(), valid_n.data(), train_dataset_size, valid_dataset_size,
+        neg_sampling, cli.get_neg_hard_pool(),
+        neg_sampling == kNegHard ? emb.get() : nullptr, preproc_gen);
+    }, emb_cached ? num_threads : walk_split.side);
+
+    pipeline.AddStage("CLASSIFIER", {emb_stage, "PREPROC"}, [&]() {
+      std::cout << "\n---- CLASSIFIER ----\n";
+      r.accuracy = link_prediction_clasifier(
+        g, train_p.data(), train_n.data(), test_p.data(), test_n.data(),
+        valid_p.data(), valid_n.data(), *emb, node_embedding_dim,
+        train_dataset_size, test_dataset_size, valid_dataset_size,
+        cli.get_output_dim(), cli.get_learning_rate(), cli.get_num_epochs(),
+        cli.get_hidden_layer_dim(), cli.get_batch_size(),
+        cli.get_eval_batch_size(), cli.get_target_val_accuracy(),
+        num_threads, cli.get_num_workers(), "");
+    });
+
+    pipeline.Run();
+    pipeline.PrintTimings();
+    r.walk_time = pipeline.StageTime("RWALK");
+    r.emb_time = pipeline.StageTime(emb_stage);
+    r.preproc_time = pipeline.StageTime("PREPROC");
+    r.classifier_time = pipeline.StageTime("CLASSIFIER");
+    results.push_back(r);
+
+    // Later windows start after block w
+    drop_block(w);
+  }
+  for(int64_t b = num_windows; b < num_blocks; ++b)
+    drop_block(b);
+  t_total.Stop();
+
+  std::cout << "\n---- SNAPSHOTS ----\n";
+  printf("%12s %12s %12s %10s %10s %9s %9s %9s %9s %9s\n", "train_start",
+         "test_start", "test_end", "train_edg", "test_edg", "accuracy",
+         "rwalk(s)", "emb(s)", "preproc(s)", "classif(s)");
+  double accuracy_sum = 0;
+  for(auto &r : results) {
+    printf("%12.6g %12.6g %12.6g %10lld %10lld %9.4f %9.5f %9.5f %9.5f %9.5f\n",
+           (double) r.train.start, (double) r.test.start, (double) r.test.end,
+           r.train_edges, r.test_edges, r.accuracy, r.walk_time, r.emb_time,
+           r.preproc_time, r.classifier_time);
+    accuracy_sum += r.accuracy;
+  }
+  if(!results.empty())
+    std::cout << "Mean testing accuracy over " << results.size() << " windows: "
+              << accuracy_sum / results.size() << std::endl;
+  PrintStep("[TimingStat] Snapshot windows time (s):", t_total.Seconds());
+}
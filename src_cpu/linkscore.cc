@@ -0,0 +1,423 @@
+#include <iostream>
+#include <vector>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <map>
+#include <set>
+#include <fstream>
+#include <torch/torch.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include "benchmark.h"
+#include "builder.h"
+#include "command_line.h"
+#include "pvector.h"
+#include "timer.h"
+
+typedef NodeWeight<NodeID, WeightT> WNode;
+typedef EdgePair<NodeID, WNode> EdgeP;
+typedef pvector<EdgeP> EdgeList;
+typedef std::map<int, std::vector<float>> NodeEmb;
+
+// Edge pairs
+struct EdgePairStruct {
+  NodeID src_node;
+  NodeID dst_node;
+};
+
+#if defined(OPENMP)
+#include <omp.h>
+#define parallel_for _Pragma("omp parallel for") for
+#else
+#define parallel_for for
+#endif
+
+#include "emb_file.h"
+#include "linkpred_model.h"
+#include "kmeans.h"
+#include "topk_retrieval.h"
+#include "ann_index.h"
+
+/*
+  Link scoring service.
+  Scores candidate (src, dst) pairs with the embeddings and the classifier
+  of an earlier link-prediction run.
+  Input arguments
+  @ -m node-emb.bin
+  @+ embeddings saved with link-prediction -b
+
+  @ -x model-filename
+  @+ classifier saved with link-prediction -x
+
+  @ -c cofig-filename.txt
+  @+ the params file of that run (hidden_layer_dim, output_dim);
+  @+ eval_batch_size sets the micro-batch size
+
+  @ -i pairs-filename [-t scores-filename]
+  @+ scores a file of <src_node dst_node> lines,
+  @+ writes <src_node dst_node probability> lines
+
+  @ -d socket-path
+  @+ serves <src_node dst_node> lines over a Unix socket, answering each
+  @+ with a probability line (nan if a node has no embedding);
+  @+ a "shutdown" line stops the service
+
+  @ -q query-filename [-f graph-filename.wel] [-t scores-filename]
+  @+ retrieves the retrieve_k most similar nodes of every query node,
+  @+ skipping nodes it is already linked to in the graph; with
+  @+ rerank_shortlist > 0 that many candidates are retrieved and the
+  @+ best retrieve_k by model probability are kept.
+  @+ If node-emb.bin.ivf exists (ann_nlist), only the ann_nprobe closest
+  @+ inverted lists are scanned and recall@K against exact search is
+  @+ reported (ann_check_recall).
+  @+ writes <query_node rank dst_node similarity probability> lines
+*/
+
+class LinkScorer {
+ public:
+  LinkScorer(const EmbeddingTable &emb, std::shared_ptr<Net> net,
+             int64_t batch_size) :
+    emb_(emb), net_(net), batch_size_(batch_size),
+    features_(batch_size * 2 * emb.dim()) {
+    net_->eval();
+  }
+
+  // Scores n pairs in micro-batches: both endpoint rows are gathered into
+  // a dense [batch, 2 * dim] buffer that is fed to the model as is
+  void Score(const EdgePairStruct* pairs, int64_t n, float* out) {
+    torch::NoGradGuard no_grad;
+    int64_t dim = emb_.dim();
+    for (int64_t begin = 0; begin < n; begin += batch_size_) {
+      Timer t;
+      t.Start();
+      int64_t len = std::min(batch_size_, n - begin);
+      std::vector<char> valid(len);
+      parallel_for(int64_t i = 0; i < len; i++) {
+        int64_t src_row = emb_.RowOf(pairs[begin + i].src_node);
+        int64_t dst_row = emb_.RowOf(pairs[begin + i].dst_node);
+        float *feature = features_.data() + i * 2 * dim;
+        valid[i] = (src_row != -1) && (dst_row != -1);
+        if (valid[i]) {
+          memcpy(feature, emb_.row(src_row), dim * sizeof(float));
+          memcpy(feature + dim, emb_.row(dst_row), dim * sizeof(float));
+        } else {
+          memset(feature, 0, 2 * dim * sizeof(float));
+        }
+      }
+      torch::Tensor batch = torch::from_blob(features_.data(), {len, 2 * dim});
+      torch::Tensor prob = net_->forward(batch).view({-1}).contiguous();
+      const float *prob_data = prob.data_ptr<float>();
+      for (int64_t i = 0; i < len; i++)
+        out[begin + i] = valid[i] ? prob_data[i] : NAN;
+      t.Stop();
+      latencies_.push_back(t.Millisecs());
+      num_scored_ += len;
+    }
+  }
+
+  void PrintStats(double seconds) const {
+    std::vector<double> lat(latencies_);
+    std::sort(lat.begin(), lat.end());
+    double mean = 0;
+    for (double l : lat)
+      mean += l;
+    if (!lat.empty())
+      mean /= lat.size();
+    auto pct = [&lat](double p) {
+      return lat.empty() ? 0.0 : lat[std::min(lat.size() - 1, (size_t) (p * lat.size()))];
+    };
+    std::cout << "Scored " << num_scored_ << " pairs in " << lat.size()
+              << " micro-batches of up to " << batch_size_ << std::endl;
+    PrintStep("[TimingStat] Scoring time (s):", seconds);
+    PrintStep("[TimingStat] Throughput (pairs/s)",
+              (int64_t) (seconds > 0 ? num_scored_ / seconds : 0));
+    printf("[TimingStat] Micro-batch latency (ms): mean %.3f, p50 %.3f, p99 %.3f, max %.3f\n",
+           mean, pct(0.50), pct(0.99), lat.empty() ? 0.0 : lat.back());
+  }
+
+ private:
+  const EmbeddingTable &emb_;
+  std::shared_ptr<Net> net_;
+  int64_t batch_size_;
+  std::vector<float> features_;
+  std::vector<double> latencies_;
+  int64_t num_scored_ = 0;
+};
+
+void score_pairs_file(LinkScorer &scorer, std::string pairs_file,
+                      std::string scores_file)
+{
+  std::vector<EdgePairStruct> pairs;
+  std::ifstream in(pairs_file);
+  if (!in) {
+    std::cout << "Couldn't open pairs file " << pairs_file << std::endl;
+    std::exit(-71);
+  }
+  EdgePairStruct p;
+  while (in >> p.src_node >> p.dst_node)
+    pairs.push_back(p);
+  std::cout << "Read " << pairs.size() << " pairs from " << pairs_file << std::endl;
+
+  std::vector<float> scores(pairs.size());
+  Timer t;
+  t.Start();
+  scorer.Score(pairs.data(), pairs.size(), scores.data());
+  t.Stop();
+  scorer.PrintStats(t.Seconds());
+
+  std::ofstream out(scores_file);
+  for (size_t i = 0; i < pairs.size(); i++)
+    out << pairs[i].src_node << " " << pairs[i].dst_node << " " << scores[i] << "\n";
+  std::cout << "Wrote scores to " << scores_file << std::endl;
+}
+
+void retrieve_links(LinkScorer &scorer, const EmbeddingTable &emb,
+                    const IVFIndex *index, int nprobe, bool check_recall,
+                    const WGraph *g, std::string query_file,
+                    std::string scores_file, int k, int rerank_shortlist)
+{
+  std::vector<NodeID> queries;
+  std::ifstream in(query_file);
+  if (!in) {
+    std::cout << "Couldn't open query file " << query_file << std::endl;
+    std::exit(-73);
+  }
+  NodeID q;
+  while (in >> q)
+    queries.push_back(q);
+  std::cout << "Read " << queries.size() << " query nodes from " << query_file << std::endl;
+
+  bool rerank = rerank_shortlist > 0;
+  size_t num_retrieved = rerank ? std::max(rerank_shortlist, k) : k;
+  Timer t;
+  t.Start();
+  std::vector<LinkCandidates> candidates = (index != nullptr) ?
+    index->Search(emb, queries, num_retrieved, nprobe, g) :
+    RetrieveTopK(emb, queries, num_retrieved, g);
+  t.Stop();
+  PrintStep("[TimingStat] Retrieval time (s):", t.Seconds());
+  PrintStep("[TimingStat] Queries per second",
+            (int64_t) (t.Seconds() > 0 ? queries.size() / t.Seconds() : 0));
+  if ((index != nullptr) && check_recall) {
+    // Exact search over all embeddings as the reference
+    Timer t_exact;
+    t_exact.Start();
+    std::vector<LinkCandidates> exact = RetrieveTopK(emb, queries, num_retrieved, g);
+    t_exact.Stop();
+    PrintStep("[TimingStat] Exact retrieval time (s):", t_exact.Seconds());
+    printf("Recall@%zu of IVF (nlist %" PRId64 ", nprobe %d): %.4f\n",
+           num_retrieved, index->nlist(), nprobe, RecallAtK(exact, candidates));
+  }
+
+  // Probabilities of all retrieved pairs, in one scoring pass
+  std::vector<EdgePairStruct> pairs;
+  for (size_t i = 0; i < queries.size(); i++)
+    for (auto &c : candidates[i])
+      pairs.push_back({queries[i], c.second});
+  std::vector<float> prob(pairs.size());
+  t.Start();
+  scorer.Score(pairs.data(), pairs.size(), prob.data());
+  t.Stop();
+  if (rerank)
+    scorer.PrintStats(t.Seconds());
+
+  std::ofstream out(scores_file);
+  size_t offset = 0;
+  for (size_t i = 0; i < queries.size(); i++) {
+    size_t num_cand = candidates[i].size();
+    std::vector<size_t> order(num_cand);
+    for (size_t c = 0; c < num_cand; c++)
+      order[c] = c;
+    if (rerank)
+      std::stable_sort(order.begin(), order.end(), [&](size_t a, size_t b) {
+        return prob[offset + a] > prob[offset + b];
+      });
+    for (size_t rank = 0; rank < std::min(num_cand, (size_t) k); rank++) {
+      size_t c = order[rank];
+      out << queries[i] << " " << rank + 1 << " " << candidates[i][c].second
+          << " " << candidates[i][c].first << " " << prob[offset + c] << "\n";
+    }
+    offset += num_cand;
+  }
+  std::cout << "Wrote top-" << k << " links to " << scores_file << std::endl;
+}
+
+// Writes all of buf, returns false if the client went away
+bool write_all(int fd, const std::string &buf)
+{
+  size_t done = 0;
+  while (done < buf.size()) {
+    ssize_t n = write(fd, buf.data() + done, buf.size() - done);
+    if (n <= 0)
+      return false;
+    done += n;
+  }
+  return true;
+}
+
+/*
+  Serves one client at a time. Every read() drains the complete lines
+  received so far, so a client that pipelines many pairs gets them scored
+  in large micro-batches while a single pair is answered right away.
+*/
+void serve_socket(LinkScorer &scorer, std::string socket_path)
+{
+  int server = socket(AF_UNIX, SOCK_STREAM, 0);
+  struct sockaddr_un addr;
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  if (server < 0 || socket_path.size() >= sizeof(addr.sun_path)) {
+    std::cout << "Couldn't create socket " << socket_path << std::endl;
+    std::exit(-72);
+  }
+  strncpy(addr.sun_path, socket_path.c_str(), sizeof(addr.sun_path) - 1);
+  unlink(socket_path.c_str());
+  if (bind(server, (struct sockaddr*) &addr, sizeof(addr)) < 0 ||
+      listen(server, 16) < 0) {
+    std::cout << "Couldn't listen on socket " << socket_path << std::endl;
+    std::exit(-72);
+  }
+  std::cout << "Listening on " << socket_path << std::endl;
+
+  Timer t_busy;
+  double busy_seconds = 0;
+  bool shutdown = false;
+  std::vector<char> recv_buf(1 << 20);
+  while (!shutdown) {
+    int client = accept(server, nullptr, nullptr);
+    if (client < 0)
+      continue;
+    std::string pending;
+    bool eof = false;
+    while (!shutdown && !eof) {
+      ssize_t n = read(client, recv_buf.data(), recv_buf.size());
+      if (n > 0) {
+        pending.append(recv_buf.data(), n);
+      } else {
+        // The client is done sending; its last line may lack a newline
+        eof = true;
+        if (n < 0 || pending.empty())
+          break;
+        pending += '\n';
+      }
+      size_t last_newline = pending.rfind('\n');
+      if (last_newline == std::string::npos)
+        continue;
+      t_busy.Start();
+      std::vector<EdgePairStruct> pairs;
+      std::vector<char> parsed;
+      size_t line_start = 0;
+      while (line_start <= last_newline) {
+        size_t line_end = pending.find('\n', line_start);
+        std::string line = pending.substr(line_start, line_end - line_start);
+        line_start = line_end + 1;
+        if (line.compare(0, 8, "shutdown") == 0) {
+          shutdown = true;
+          break;
+        }
+        EdgePairStruct p;
+        char *end;
+        p.src_node = strtoll(line.c_str(), &end, 10);
+        bool ok = (end != line.c_str());
+        const char *dst_start = end;
+        p.dst_node = strtoll(dst_start, &end, 10);
+        ok = ok && (end != dst_start);
+        parsed.push_back(ok);
+        if (!ok)
+          p.src_node = p.dst_node = -1;
+        pairs.push_back(p);
+      }
+      pending.erase(0, last_newline + 1);
+
+      std::vector<float> scores(pairs.size());
+      scorer.Score(pairs.data(), pairs.size(), scores.data());
+      std::string reply;
+      char line[32];
+      for (size_t i = 0; i < pairs.size(); i++) {
+        if (parsed[i])
+          snprintf(line, sizeof(line), "%.6f\n", scores[i]);
+        else
+          snprintf(line, sizeof(line), "error\n");
+        reply += line;
+      }
+      t_busy.Stop();
+      busy_seconds += t_busy.Seconds();
+      if (!write_all(client, reply))
+        break;
+    }
+    close(client);
+  }
+  close(server);
+  unlink(socket_path.c_str());
+  scorer.PrintStats(busy_seconds);
+}
+
+int main(int argc, char* argv[]) {
+
+  CLLinkScore cli(argc, argv, "link-score");
+
+  if (!cli.ParseArgs())
+    return -1;
+
+  // Read parameter configuration file
+  cli.read_params_file();
+
+  // Number of threads
+  int num_threads;
+  if(cli.use_max_num_threads() == 1) num_threads = omp_get_max_threads();
+  else num_threads = cli.get_num_threads();
+  omp_set_num_threads(num_threads);
+  torch::set_num_threads(num_threads);
+  printf("Using %d thread(s) for running.\n", num_threads);
+
+  std::cout << "\n---- EMBEDDINGS ----\n";
+  EmbeddingTable emb(cli.get_emb_in_file_name());
+  std::cout << "Mapped " << emb.count() << " x " << emb.dim()
+            << " embeddings from " << cli.get_emb_in_file_name() << std::endl;
+
+  std::cout << "\n---- MODEL ----\n";
+  auto net = std::make_shared<Net>(
+    2 * emb.dim(),
+    cli.get_output_dim(),
+    cli.get_hidden_layer_dim()
+  );
+  torch::load(net, cli.get_model_file_name());
+  std::cout << "Loaded link predictor from " << cli.get_model_file_name() << std::endl;
+
+  std::cout << "\n---- SCORING ----\n";
+  LinkScorer scorer(emb, net, cli.get_eval_batch_size());
+  if(cli.pairs_file_name() != "") {
+    score_pairs_file(scorer, cli.pairs_file_name(), cli.scores_file_name());
+  } else if(cli.query_file_name() != "") {
+    std::cout << "\n---- RETRIEVAL ----\n";
+    WGraph g;
+    if(cli.filename() != "") {
+      WeightedBuilder b(cli);
+      EdgeList el;
+      g = b.MakeGraph(&el);
+    }
+    IVFIndex index;
+    bool use_index = (cli.get_ann_nprobe() > 0) &&
+                     index.Load(cli.get_emb_in_file_name(), emb);
+    retrieve_links(
+      /* scorer */ scorer,
+      /* embeddings */ emb,
+      /* ANN index, exact search if none */ use_index ? &index : nullptr,
+      /* lists probed per query */ cli.get_ann_nprobe(),
+      /* compare against exact search */ cli.get_ann_check_recall() == 1,
+      /* graph with links to exclude */ cli.filename() != "" ? &g : nullptr,
+      /* query nodes */ cli.query_file_name(),
+      /* output file */ cli.scores_file_name(),
+      /* number of links per query */ cli.get_retrieve_k(),
+      /* candidates re-ranked by the model */ cli.get_rerank_shortlist()
+    );
+  } else {
+    serve_socket(scorer, cli.socket_path());
+  }
+
+  return 0;
+}
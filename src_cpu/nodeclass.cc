@@ -67,8 +67,15 @@ bool print_datasets = false;
 #define parallel_for for
 #endif
 
+#include "temporal_csr.h"
+#include "reorder.h"
 #include "rwalk.h"
+#include "emb_file.h"
+#include "kmeans.h"
 #include "word2vec.h"
+#include "topk_retrieval.h"
+#include "ann_index.h"
+#include "pipeline.h"
 #include "nodeclass_dataloader.h"
 #include "nodeclass_model.h"
 #include "nodeclass_classifier.h"
@@ -102,20 +109,35 @@ int main(int argc, char* argv[]) {
   EdgeList el;
   WGraph g = b.MakeGraph(&el);
   NodeEmb node_emb;
+  std::unique_ptr<EmbeddingTable> emb;
 
   // Read parameter configuration file
   cli.read_params_file();
 
+  // Temporal squish of the graph before walking
+  if(cli.get_dedup_edges() || cli.get_keep_last_k() > 0)
+    g = WeightedBuilder::SquishTemporalGraph(g, cli.get_dedup_edges(),
+                                             cli.get_keep_last_k());
+
   // Parameter initialization
   int   max_walk_length     =   cli.get_max_walk_length();
   int   node_embedding_dim  =   cli.get_node_emb_dim();
   int   num_walks_per_node  =   cli.get_num_walks_per_node();
+  WalkBias walk_bias        =   ParseWalkBias(cli.get_walk_bias());
+  WalkStart walk_start      =   MakeWalkStart(g,
+    ParseWalkStartTime(cli.get_walk_start_time()), cli.get_walk_window());
+  int64_t num_edge_walks    =   cli.get_num_edge_walks();
+  EdgeStartBias edge_walk_bias = ParseEdgeStartBias(cli.get_edge_walk_bias());
+  WalkLayout walk_layout    =   ParseWalkLayout(cli.get_walk_layout());
+  NodeOrdering walk_order   =   ParseNodeOrdering(cli.get_walk_order());
+  TimeWindow walk_window    =   ParseTimeWindow(cli.get_walk_time_window(), nullptr);
   int   num_workers         =   cli.get_num_workers();
   float learning_rate       =   cli.get_learning_rate();
   int   num_epochs          =   cli.get_num_epochs();
   int   hidden_layer1_dim   =   cli.get_hidden_layer1_dim();
   int   hidden_layer2_dim   =   cli.get_hidden_layer2_dim();
   int   batch_size          =   cli.get_batch_size();
+  int   eval_batch_size     =   cli.get_eval_batch_size();
   float target_accuracy     =   cli.get_target_val_accuracy();
   
   std::string training_file_path = cli.get_training_file_name();
@@ -135,6 +157,14 @@ int main(int argc, char* argv[]) {
   std::cout << "num_threads           : " << num_threads << std::endl;
   std::cout << "num_walks_per_node    : " << num_walks_per_node << std::endl;
   std::cout << "max_walk_length       : " << max_walk_length << std::endl;
+  std::cout << "walk_bias             : " << cli.get_walk_bias() << std::endl;
+  std::cout << "walk_start_time       : " << cli.get_walk_start_time() << std::endl;
+  std::cout << "num_edge_walks        : " << num_edge_walks << std::endl;
+  std::cout << "walk_layout           : " << cli.get_walk_layout() << std::endl;
+  std::cout << "walk_order            : " << cli.get_walk_order() << std::endl;
+  std::cout << "dedup_edges           : " << cli.get_dedup_edges() << std::endl;
+  std::cout << "keep_last_k           : " << cli.get_keep_last_k() << std::endl;
+  std::cout << "walk_time_window      : " << cli.get_walk_time_window() << std::endl;
   std::cout << "node_embedding_dim    : " << node_embedding_dim << std::endl;
   std::cout << "num_workers           : " << num_workers << std::endl;
   std::cout << "learning_rate         : " << learning_rate << std::endl;
@@ -142,117 +172,210 @@ int main(int argc, char* argv[]) {
   std::cout << "hidden_layer1_dim     : " << hidden_layer1_dim << std::endl;
   std::cout << "hidden_layer2_dim     : " << hidden_layer2_dim << std::endl;
   std::cout << "batch_size            : " << batch_size << std::endl;
+  std::cout << "eval_batch_size       : " << eval_batch_size << std::endl;
   std::cout << "target_accuracy       : " << target_accuracy << std::endl;
   std::cout << "training_file_path    : " << training_file_path << std::endl;
   std::cout << "validation_file_path  : " << validation_file_path << std::endl;
   std::cout << "testing_file_path     : " << testing_file_path << std::endl;
 
-  // Compute temporal random walk
-  std::cout << "\n---- RWALK ----\n";
-  compute_random_walk(
-    /* temporal graph */ g, 
-    /* max random walk length */ max_walk_length,
-    /* number of rwalks/node */ num_walks_per_node,
-    /* filename of random walk */ "out_random_walk.txt"
-  );
-
-  // Call word2vec function to create node embeddings
-  std::cout << "\n---- WORD2VEC ----\n";
-  custom_word2vec(
-    /* node embedding map */ &node_emb,
-    /* train_file */ "out_random_walk.txt",   // TODO: remove this
-    /* output_file */ "node_emb.txt",         // TODO: remove this
-    /* layer1_size */ node_embedding_dim,     // TODO: pass it from the command line
-    /* min_cnt */ 0,
-    /* window */ 10,
-    /* iter */ 10, 
-    /* cbow */ 0, // skip-gram model
-    /* num_threads */ num_threads,
-    /* print embedding to a file */ print_datasets
-  );
-
-  // Find the size of training/testing data
+  // Task graph: RWALK -> WORD2VEC -> CLASSIFIER, PREPROC -> CLASSIFIER;
+  // reading the labeled datasets does not need the embeddings
+  bool overlap = cli.get_pipeline_overlap() == 1;
+  TaskPipeline pipeline(overlap);
+  // Threads of the concurrent stages: PREPROC reads the datasets on one
+  // thread next to RWALK and WORD2VEC, KMEANS runs next to CLASSIFIER
+  ThreadSplit walk_split(num_threads, overlap && cli.get_emb_in_file_name() == "", 1);
+  ThreadSplit classifier_split(num_threads, overlap && cli.get_kmeans_clusters() > 0);
+  std::string emb_stage;
+  // The walks draw from their own generator, seeded here
+  std::mt19937 walk_gen(rng());
+
+  if(cli.get_emb_in_file_name() != "") {
+    emb_stage = "EMBEDDINGS";
+    pipeline.AddStage(emb_stage, {}, [&]() {
+      // Reuse embeddings of a previous run, skipping rwalk and word2vec
+      std::cout << "\n---- EMBEDDINGS ----\n";
+      emb.reset(LoadEmbeddingFile(cli.get_emb_in_file_name()));
+      if(emb->dim() != node_embedding_dim) {
+        std::cout << "Using node_embedding_dim " << emb->dim()
+                  << " of the embedding file\n";
+        node_embedding_dim = emb->dim();
+      }
+      if(cli.get_emb_out_file_name() != "") {
+        WriteEmbeddingFile(*emb, cli.get_emb_out_file_name());
+        if(cli.get_ann_nlist() > 0)
+          BuildEmbeddingIndex(cli.get_emb_out_file_name(), cli.get_ann_nlist(), 10);
+      }
+    });
+  } else {
+    pipeline.AddStage("RWALK", {}, [&]() {
+      // Compute temporal random walk
+      std::cout << "\n---- RWALK ----\n";
+      if(num_edge_walks > 0)
+        compute_edge_walks(
+          /* temporal graph */ g, 
+          /* max random walk length */ max_walk_length,
+          /* number of rwalks in total */ num_edge_walks,
+          /* filename of random walk */ "out_random_walk.txt",
+          /* temporal bias of the walks */ walk_bias,
+          /* bias of the initial edges */ edge_walk_bias,
+          /* generator of the walks */ walk_gen,
+          /* time window of the walked edges */ walk_window
+        );
+      else
+        compute_random_walk_on_layout(
+          /* temporal graph */ g, 
+          /* graph layout of the walks */ walk_layout,
+          /* node ordering of the walks */ walk_order,
+          /* time quantum of the compressed layout */ cli.get_csr_time_resolution(),
+          /* max random walk length */ max_walk_length,
+          /* number of rwalks/node */ num_walks_per_node,
+          /* filename of random walk */ "out_random_walk.txt",
+          /* temporal bias of the walks */ walk_bias,
+          /* initial time of the walks */ walk_start,
+          /* generator of the walks */ walk_gen,
+          /* time window of the walked edges */ walk_window
+        );
+    }, walk_split.main);
+
+    emb_stage = "WORD2VEC";
+    pipeline.AddStage(emb_stage, {"RWALK"}, [&]() {
+      // Call word2vec function to create node embeddings
+      std::cout << "\n---- WORD2VEC ----\n";
+      custom_word2vec(
+        /* node embedding map */ &node_emb,
+        /* train_file */ "out_random_walk.txt",   // TODO: remove this
+        /* output_file */ "node_emb.txt",         // TODO: remove this
+        /* layer1_size */ node_embedding_dim,     // TODO: pass it from the command line
+        /* min_cnt */ 0,
+        /* window */ 10,
+        /* iter */ 10, 
+        /* cbow */ 0, // skip-gram model
+        /* num_threads */ walk_split.main,
+        /* print embedding to a file */ print_datasets
+      );
+      // The later stages read the rows of one contiguous table
+      emb.reset(new EmbeddingTable(node_emb, node_embedding_dim));
+      NodeEmb().swap(node_emb);
+      if(cli.get_emb_out_file_name() != "") {
+        WriteEmbeddingFile(*emb, cli.get_emb_out_file_name());
+        if(cli.get_ann_nlist() > 0)
+          BuildEmbeddingIndex(cli.get_emb_out_file_name(), cli.get_ann_nlist(), 10);
+      }
+    }, walk_split.main);
+  }
+
   InputDataSize in_data_size;
-  std::ifstream train_input(training_file_path);
-  if(train_input)
-  {
-    int cnt = 0;
-    std::string in_line;
-    while(getline(train_input, in_line))
+  LabeledData* training_labeled_data = nullptr;
+  LabeledData* validation_labeled_data = nullptr;
+  LabeledData* testing_labeled_data = nullptr;
+  int output_dim = 0;
+
+  pipeline.AddStage("PREPROC", {}, [&]() {
+    // Find the size of training/testing data
+    std::ifstream train_input(training_file_path);
+    if(train_input)
     {
-      cnt++;
+      int cnt = 0;
+      std::string in_line;
+      while(getline(train_input, in_line))
+      {
+        cnt++;
+      }
+      in_data_size.training_data_size = cnt;
     }
-    in_data_size.training_data_size = cnt;
-  }
-  train_input.close();
+    train_input.close();
   
-  std::ifstream valid_input(validation_file_path);
-  if(valid_input)
-  {
-    int cnt = 0;
-    std::string in_line;
-    while(getline(valid_input, in_line))
+    std::ifstream valid_input(validation_file_path);
+    if(valid_input)
     {
-      cnt++;
+      int cnt = 0;
+      std::string in_line;
+      while(getline(valid_input, in_line))
+      {
+        cnt++;
+      }
+      in_data_size.validation_data_size = cnt;
     }
-    in_data_size.validation_data_size = cnt;
-  }
-  valid_input.close();
-
-  std::ifstream test_input(testing_file_path);
-  if(test_input)
-  {
-    int cnt = 0;
-    std::string in_line;
-    while(getline(test_input, in_line))
+    valid_input.close();
+
+    std::ifstream test_input(testing_file_path);
+    if(test_input)
     {
-      cnt++;
+      int cnt = 0;
+      std::string in_line;
+      while(getline(test_input, in_line))
+      {
+        cnt++;
+      }
+      in_data_size.testing_data_size = cnt;
     }
-    in_data_size.testing_data_size = cnt;
-  }
-  test_input.close();
+    test_input.close();
 
-  printf("Size of datasets: traing %d, validation %d, testing %d\n", 
-    in_data_size.training_data_size,
-    in_data_size.validation_data_size,
-    in_data_size.testing_data_size);
+    printf("Size of datasets: traing %d, validation %d, testing %d\n", 
+      in_data_size.training_data_size,
+      in_data_size.validation_data_size,
+      in_data_size.testing_data_size);
 
-  LabeledData* training_labeled_data    = new LabeledData[in_data_size.training_data_size];
-  LabeledData* validation_labeled_data  = new LabeledData[in_data_size.validation_data_size];
-  LabeledData* testing_labeled_data     = new LabeledData[in_data_size.testing_data_size];
+    training_labeled_data    = new LabeledData[in_data_size.training_data_size];
+    validation_labeled_data  = new LabeledData[in_data_size.validation_data_size];
+    testing_labeled_data     = new LabeledData[in_data_size.testing_data_size];
   
-  std::cout << "\n---- PREPROC ----\n";
-  // Data pre-processing step to create dataset for the classifier
-  int output_dim = 
-    node_classification_data_preprocessing(
-      /* labeled training file name */ training_file_path,
-      /* labeled validation file name */ validation_file_path,
-      /* labeled testing file name */ testing_file_path,
+    std::cout << "\n---- PREPROC ----\n";
+    // Data pre-processing step to create dataset for the classifier
+    output_dim = 
+      node_classification_data_preprocessing(
+        /* labeled training file name */ training_file_path,
+        /* labeled validation file name */ validation_file_path,
+        /* labeled testing file name */ testing_file_path,
+        /* labeled training data */ training_labeled_data,
+        /* labeled validation data */ validation_labeled_data,
+        /* labeled testing data */ testing_labeled_data,
+        /* data size */ in_data_size
+      );
+  }, walk_split.side);
+
+  pipeline.AddStage("CLASSIFIER", {emb_stage, "PREPROC"}, [&]() {
+    std::cout << "\n---- CLASSIFIER ----\n";
+    std::cout << "output_dim: " << output_dim << std::endl;
+    node_classification_classifier(
       /* labeled training data */ training_labeled_data,
       /* labeled validation data */ validation_labeled_data,
       /* labeled testing data */ testing_labeled_data,
-      /* data size */ in_data_size
+      /* size of training/testing datasets */ in_data_size,
+      /* node embeddings */ *emb,
+      /* node embedding dimension */ node_embedding_dim,
+      /* output dim of the classifier */ output_dim,
+      /* learning rate */ learning_rate,
+      /* number of epochs for training */ num_epochs,
+      /* number of neurons in the hidden layer1 */ hidden_layer1_dim,
+      /* number of neurons in the hidden layer2 */ hidden_layer2_dim,
+      /* batch size */ batch_size,
+      /* batch size of validation/testing */ eval_batch_size,
+      /* target validation accuracy */ target_accuracy,
+      /* number of threads */ classifier_split.main,
+      /* number of workers for parallel data loader */ num_workers
     );
+  }, classifier_split.main);
+
+  if(cli.get_kmeans_clusters() > 0) {
+    pipeline.AddStage("KMEANS", {emb_stage}, [&]() {
+      // Cluster the node embeddings next to the classifier
+      std::cout << "\n---- KMEANS ----\n";
+      ClusterEmbeddings(
+        /* node embeddings */ *emb,
+        /* number of clusters */ cli.get_kmeans_clusters(),
+        /* max iterations */ cli.get_kmeans_iter(),
+        /* fraction of changed assignments to stop at */ cli.get_kmeans_tol(),
+        /* seed of k-means++ */ cli.get_random_seed() >= 0 ?
+          (unsigned) cli.get_random_seed() : std::random_device{}(),
+        /* file of node clusters */ cli.get_kmeans_file()
+      );
+    }, classifier_split.side);
+  }
 
-  std::cout << "\n---- CLASSIFIER ----\n";
-  std::cout << "output_dim: " << output_dim << std::endl;
-  node_classification_classifier(
-    /* labeled training data */ training_labeled_data,
-    /* labeled validation data */ validation_labeled_data,
-    /* labeled testing data */ testing_labeled_data,
-    /* size of training/testing datasets */ in_data_size,
-    /* node embedding map */ node_emb,
-    /* node embedding dimension */ node_embedding_dim,
-    /* output dim of the classifier */ output_dim,
-    /* learning rate */ learning_rate,
-    /* number of epochs for training */ num_epochs,
-    /* number of neurons in the hidden layer1 */ hidden_layer1_dim,
-    /* number of neurons in the hidden layer2 */ hidden_layer2_dim,
-    /* batch size */ batch_size,
-    /* target validation accuracy */ target_accuracy,
-    /* number of threads */ num_threads,
-    /* number of workers for parallel data loader */ num_workers
-  );
+  pipeline.Run();
+  pipeline.PrintTimings();
 
   delete[] training_labeled_data;
   delete[] validation_labeled_data;
@@ -2,12 +2,35 @@
  * Classifier module for node classification that does both training and inference.
  */ 
 
+/*
+  Inference over a whole dataset: no autograd, a sequential sweep over the
+  contiguous feature tensor in eval_batch_size chunks, correct predictions
+  accumulated on the device and read back with a single sync at the end
+*/
+int64_t node_classification_count_correct(
+    std::shared_ptr<Net> net,
+    const torch::Tensor &features,
+    const torch::Tensor &labels,
+    int64_t eval_batch_size)
+{
+    torch::NoGradGuard no_grad;
+    net->eval();
+    int64_t num_samples = features.size(0);
+    torch::Tensor correct = torch::zeros({}, torch::kLong);
+    for (int64_t begin = 0; begin < num_samples; begin += eval_batch_size) {
+        int64_t end = std::min(begin + eval_batch_size, num_samples);
+        auto output = net->forward(features.slice(0, begin, end).to(torch::kFloat));
+        correct += output.argmax(1).eq(labels.slice(0, begin, end)).sum();
+    }
+    return correct.item<int64_t>();
+}
+
 void node_classification_classifier(
     LabeledData* training_labeled_data,
     LabeledData* validation_labeled_data,
     LabeledData* testing_labeled_data,
     InputDataSize in_data_size,
-    NodeEmb node_emb,
+    const EmbeddingTable &emb,
     int node_embedding_dim,
     // Hyperparameters
     int output_size,
@@ -16,6 +39,7 @@ void node_classification_classifier(
     int hidden_layer1_dimension,
     int hidden_layer2_dimension,
     int batch_size,
+    int eval_batch_size,
     float target_val_accuracy,
     int num_threads,
     int num_workers)
@@ -35,7 +59,7 @@ void node_classification_classifier(
     auto training_custom_dataset = CustomDataset(
         training_labeled_data,
         in_data_size.training_data_size,
-        node_emb,
+        emb,
         node_embedding_dim).map(torch::data::transforms::Stack<>());
     // int training_batch_size = training_custom_dataset.size().value() / num_batches;
     // Sampler types: SequentialSampler, RandomSampler
@@ -43,19 +67,16 @@ void node_classification_classifier(
         std::move(training_custom_dataset), 
         torch::data::DataLoaderOptions().batch_size(batch_size).workers(num_workers));
 
-    // Custom data loader for validation set
+    // Validation set, evaluated without a data loader
     std::cout << "Loading validation dataset...\n";
     auto validation_custom_dataset = CustomDataset(
         validation_labeled_data,
         in_data_size.validation_data_size,
-        node_emb,
-        node_embedding_dim).map(torch::data::transforms::Stack<>());
-    // int validation_batch_size = validation_custom_dataset.size().value() / num_batches;
-    const size_t validation_data_size = validation_custom_dataset.size().value();
-    // Sampler types: SequentialSampler, RandomSampler
-    auto valid_data_loader = torch::data::make_data_loader<torch::data::samplers::RandomSampler>(
-        std::move(validation_custom_dataset), 
-        torch::data::DataLoaderOptions().batch_size(batch_size).workers(num_workers));
+        emb,
+        node_embedding_dim);
+    torch::Tensor valid_features = validation_custom_dataset.stacked_features();
+    torch::Tensor valid_labels = validation_custom_dataset.stacked_labels();
+    const size_t validation_data_size = valid_features.size(0);
 
     // Create a network
     auto net = std::make_shared<Net>(input_size, output_size,
@@ -104,18 +125,8 @@ void node_classification_classifier(
         std::cout << "; training-loss: " << loss_acc / batch_index << std::endl;
         if(epoch % 10 == 0) {
             // Validation loop
-            net->eval();
-            float val_correct = 0;
-            for (const auto& batch : *valid_data_loader) {
-                auto data = batch.data;
-                auto targets = batch.target.view({-1});
-
-                auto output = net->forward(data);
-                
-                auto acc = (torch::exp(output)).argmax(1).eq(targets).sum();
-
-                val_correct += acc.template item<float>();
-            }
+            float val_correct = node_classification_count_correct(
+                net, valid_features, valid_labels, eval_batch_size);
             float val_accuracy = val_correct / validation_data_size;
             if(val_accuracy >= target_val_accuracy) {
                 std::cout << "Target validation accuracy of " << target_val_accuracy << " reached!\n" 
@@ -131,37 +142,24 @@ void node_classification_classifier(
 
     /* Testing phase */
 
-    // Custom data loader for testing set
+    // Testing set, evaluated without a data loader
     std::cout << "Loading testing dataset...\n";
     auto testing_custom_dataset = CustomDataset(
         testing_labeled_data,
         in_data_size.testing_data_size,
-        node_emb,
-        node_embedding_dim).map(torch::data::transforms::Stack<>());
-    // int testing_batch_size = testing_custom_dataset.size().value() / num_batches;
-    const size_t testing_data_size = testing_custom_dataset.size().value();
-    // Sampler types: SequentialSampler, RandomSampler
-    auto test_data_loader = torch::data::make_data_loader<torch::data::samplers::RandomSampler>(
-        std::move(testing_custom_dataset), 
-        torch::data::DataLoaderOptions().batch_size(batch_size).workers(num_workers));
+        emb,
+        node_embedding_dim);
+    torch::Tensor test_features = testing_custom_dataset.stacked_features();
+    torch::Tensor test_labels = testing_custom_dataset.stacked_labels();
+    const size_t testing_data_size = test_features.size(0);
 
     std::cout << "Testing...\n";
-    net->eval();
-
-    // float /* testing_loss = 0, */ testing_acc = 0;
 
     Timer t_testing;
     t_testing.Start();
 
-    size_t num_correct = 0;
-    for (const auto& batch : *test_data_loader) {
-        auto data = batch.data;
-        auto targets = batch.target.view({-1});
-        auto output = net->forward(data);
-        auto prediction = output.argmax(1);
-        // std::cout << "predition: " << prediction << std::endl;
-        num_correct += prediction.eq(targets).sum().item<int64_t>();
-    }
+    size_t num_correct = node_classification_count_correct(
+        net, test_features, test_labels, eval_batch_size);
     t_testing.Stop();
     PrintStep("[TimingStat] Testing  time (s):", t_testing.Seconds());
 
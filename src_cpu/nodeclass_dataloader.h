@@ -2,6 +2,16 @@
  * Custom data loader module for node classification.
  */
 
+// Node features are stored at the word2vec embedding storage precision
+// (see emb_real in word2vec.h) and only widened to float in get()
+#if defined(EMB_BF16)
+const auto kEmbFeatureType = torch::kBFloat16;
+#elif defined(EMB_FP16)
+const auto kEmbFeatureType = torch::kHalf;
+#else
+const auto kEmbFeatureType = torch::kFloat;
+#endif
+
 template<typename T>
 void print_vector_of_pairs(std::vector<std::pair<T,T>> in_vec) 
 {
@@ -40,7 +50,7 @@ print_map(std::map<T1, std::vector<T2>> in_map)
 void prepare_data_opt(
     LabeledData* labeled_data,
     long long int data_size,
-    NodeEmb node_emb,
+    const EmbeddingTable &emb,
     int node_emb_dim,
     torch::Tensor* node_features,
     torch::Tensor* node_labels
@@ -48,9 +58,10 @@ void prepare_data_opt(
 {
     for(long long int i=0; i<data_size; ++i)
     {
-        std::vector<float> this_node_emb = node_emb.at(labeled_data[i].node_id);
-        torch::Tensor this_emb = torch::from_blob(this_node_emb.data(), 
-            {node_emb_dim}).clone();
+        // from_blob only wraps the row in place, the copy of to() owns it
+        float* this_node_emb = const_cast<float*>(emb.EmbeddingOf(labeled_data[i].node_id));
+        torch::Tensor this_emb = torch::from_blob(this_node_emb, 
+            {node_emb_dim}).to(kEmbFeatureType, /*non_blocking=*/false, /*copy=*/true);
         torch::Tensor this_label = torch::full({1}, labeled_data[i].node_label, torch::kLong);
         node_features[i] = this_emb;
         node_labels[i] = this_label;
@@ -63,7 +74,6 @@ private:
     LabeledData* labeled_data;
     long long int data_size;
     int node_emb_dim;
-    NodeEmb node_emb;
     torch::Tensor* node_emb_priv;
     torch::Tensor* labels_priv;
 public:
@@ -71,14 +81,13 @@ public:
     CustomDataset(
         LabeledData* labeled_data_in,
         long long int data_size_in,
-        NodeEmb node_emb_in,
+        const EmbeddingTable &emb,
         int node_emb_dim_in) 
     {
         data_size = data_size_in;
         node_emb_dim = node_emb_dim_in;
         labeled_data = new LabeledData[data_size];
         labeled_data = labeled_data_in;
-        node_emb = node_emb_in;
 
         node_emb_priv = new torch::Tensor[data_size];
         labels_priv = new torch::Tensor[data_size];
@@ -86,7 +95,7 @@ public:
         prepare_data_opt(
             labeled_data,
             data_size,
-            node_emb,
+            emb,
             node_emb_dim,
             node_emb_priv, 
             labels_priv
@@ -108,7 +117,21 @@ public:
         // std::cout << "index: " << index << std::endl;
         torch::Tensor sample_node_id = node_emb_priv[index];
         torch::Tensor sample_label   = labels_priv[index];
-        return {sample_node_id.clone(), sample_label.clone()};
+        return {sample_node_id.to(torch::kFloat, /*non_blocking=*/false, /*copy=*/true),
+                sample_label.clone()};
+    };
+
+    // Whole dataset as one contiguous [size, dim] feature tensor (kept at
+    // the storage precision) and a [size] label tensor, for the sequential
+    // inference sweep that bypasses the data loader
+    torch::Tensor stacked_features() const
+    {
+        return torch::stack(torch::TensorList(node_emb_priv, data_size));
+    };
+
+    torch::Tensor stacked_labels() const
+    {
+        return torch::cat(torch::TensorList(labels_priv, data_size));
     };
 
     // Return the length of data
@@ -0,0 +1,187 @@
+/*
+ * Task-graph driver for the end-to-end benchmarks.
+ * Stages are added with the names of the stages they depend on; Run()
+ * starts every stage on its own thread as soon as its dependencies are
+ * done, so independent stages (e.g. PREPROC next to RWALK and WORD2VEC)
+ * overlap. Stages that run concurrently are given their share of the
+ * threads, so they do not oversubscribe the cores. Afterwards the
+ * per-stage start/end times and the critical path through the task graph
+ * are reported.
+ */
+
+#include <functional>
+#include <future>
+#include <thread>
+
+/*
+  Threads of two stages that run concurrently, a main one and a side one
+  (e.g. RWALK and PREPROC): with overlap the side stage gets side_threads
+  (default: a quarter of num_threads) and the main stage the rest, so
+  together they do not oversubscribe the cores; without overlap both get
+  all of them.
+*/
+struct ThreadSplit {
+  int main;
+  int side;
+  ThreadSplit(int num_threads, bool overlap, int side_threads = 0)
+    : main(num_threads), side(num_threads)
+  {
+    if (overlap && num_threads > 1) {
+      side = side_threads > 0 ? std::min(side_threads, num_threads - 1)
+                              : std::max(1, num_threads / 4);
+      main = num_threads - side;
+    }
+  }
+};
+
+class TaskPipeline {
+ public:
+  // overlap = false runs the stages one after another in insertion order
+  explicit TaskPipeline(bool overlap = true) : overlap_(overlap) {}
+
+  // num_threads is the OpenMP team of the stage, 0 for the whole team
+  void AddStage(
+    std::string name,
+    std::vector<std::string> deps,
+    std::function<void()> fn,
+    int num_threads = 0)
+  {
+    Stage s;
+    s.name = name;
+    s.fn = fn;
+    s.num_threads = num_threads;
+    for (auto &d : deps) {
+      auto it = index_.find(d);
+      if (it == index_.end()) {
+        std::cout << "Stage " << name << " depends on unknown stage " << d
+                  << std::endl;
+        std::exit(-61);
+      }
+      s.deps.push_back(it->second);
+    }
+    index_[name] = stages_.size();
+    stages_.push_back(s);
+  }
+
+  void Run()
+  {
+    // Stage threads are not OpenMP threads and would start with
+    // the default team size, so they get the current one or their own
+    int num_threads = 1;
+#ifdef _OPENMP
+    num_threads = omp_get_max_threads();
+#endif
+    for (auto &s : stages_)
+      if (s.num_threads <= 0)
+        s.num_threads = num_threads;
+    t_total_.Start();
+    if (!overlap_) {
+      for (size_t i = 0; i < stages_.size(); i++) {
+        SetThreads(stages_[i].num_threads);
+        RunStage(i);
+      }
+      SetThreads(num_threads);
+    } else {
+      // Stages are added after their dependencies,
+      // so every dependency already has a future
+      std::vector<std::shared_future<void>> done(stages_.size());
+      for (size_t i = 0; i < stages_.size(); i++) {
+        std::vector<std::shared_future<void>> deps;
+        for (size_t d : stages_[i].deps)
+          deps.push_back(done[d]);
+        done[i] = std::async(std::launch::async, [this, i, deps]() {
+          SetThreads(stages_[i].num_threads);
+          for (auto &d : deps)
+            d.wait();
+          RunStage(i);
+        }).share();
+      }
+      for (auto &d : done)
+        d.get();
+    }
+    t_total_.Stop();
+  }
+
+  // Time (s) the stage took in the last Run(); 0 for unknown stages
+  double StageTime(std::string name) const
+  {
+    auto it = index_.find(name);
+    if (it == index_.end())
+      return 0;
+    return stages_[it->second].end - stages_[it->second].start;
+  }
+
+  void PrintTimings() const
+  {
+    std::cout << "\n---- PIPELINE ----\n";
+    printf("%-12s %8s %10s %10s %10s\n", "stage", "threads", "start(s)",
+           "end(s)", "time(s)");
+    for (auto &s : stages_)
+      printf("%-12s %8d %10.5f %10.5f %10.5f\n", s.name.c_str(), s.num_threads,
+             s.start, s.end, s.end - s.start);
+
+    // Longest path through the task graph by stage time; stages are
+    // stored after their dependencies, so one pass in order suffices
+    if (stages_.empty())
+      return;
+    std::vector<double> path_time(stages_.size());
+    std::vector<int> critical_dep(stages_.size(), -1);
+    size_t last = 0;
+    for (size_t i = 0; i < stages_.size(); i++) {
+      double dep_time = 0;
+      for (size_t d : stages_[i].deps) {
+        if (critical_dep[i] == -1 || path_time[d] > dep_time) {
+          dep_time = path_time[d];
+          critical_dep[i] = d;
+        }
+      }
+      path_time[i] = dep_time + stages_[i].end - stages_[i].start;
+      if (path_time[i] > path_time[last])
+        last = i;
+    }
+    double critical_time = path_time[last];
+    std::string critical_path;
+    for (int cur = last; cur != -1; cur = critical_dep[cur])
+      critical_path = stages_[cur].name +
+                      (critical_path.empty() ? "" : " -> ") + critical_path;
+    std::cout << "Critical path: " << critical_path << std::endl;
+    PrintStep("[TimingStat] Critical path time (s):", critical_time);
+    PrintStep("[TimingStat] Pipeline time      (s):", t_total_.Seconds());
+  }
+
+ private:
+  struct Stage {
+    std::string name;
+    std::vector<size_t> deps;
+    std::function<void()> fn;
+    int num_threads = 0;
+    double start = 0;
+    double end = 0;
+  };
+
+  static void SetThreads(int num_threads)
+  {
+#ifdef _OPENMP
+    omp_set_num_threads(num_threads);
+#endif
+  }
+
+  void RunStage(size_t i)
+  {
+    stages_[i].start = SincePipelineStart();
+    stages_[i].fn();
+    stages_[i].end = SincePipelineStart();
+  }
+
+  double SincePipelineStart() const
+  {
+    Timer t = t_total_;
+    t.Stop();
+    return t.Seconds();
+  }
+
+  bool overlap_;
+  std::vector<Stage> stages_;
+  std::map<std::string, size_t> index_;
+  Timer t_total_;
+};
@@ -0,0 +1,271 @@
+/*
+ * Node orderings that improve the cache locality of the temporal walks
+ * (walk_order in the params files). An ordering maps every node to a
+ * new ID; the walks run on a copy of the graph relabeled by
+ * BuilderBase::RelabelByMapping (edges keep their timestamps) and are
+ * mapped back to the original IDs when written, so word2vec, the
+ * embeddings and the labels only ever see original IDs.
+ *  - degree: decreasing total (in + out) degree, hubs first
+ *  - rcm: reverse Cuthill-McKee over the undirected view of the graph
+ *  - gorder: greedy Gorder (Wei et al., SIGMOD'16): the next node is the
+ *    one with the most edges and shared in-neighbors to the last
+ *    kGorderWindow placed nodes
+ */
+
+#include <numeric>
+
+#include "bitmap.h"
+
+enum NodeOrdering { kOrderNone, kOrderDegree, kOrderRCM, kOrderGorder };
+
+NodeOrdering ParseNodeOrdering(std::string name)
+{
+  if(name == "none") return kOrderNone;
+  if(name == "degree") return kOrderDegree;
+  if(name == "rcm") return kOrderRCM;
+  if(name == "gorder") return kOrderGorder;
+  std::cout << "Unknown walk_order " << name
+            << " (none, degree, rcm, gorder)" << std::endl;
+  std::exit(-96);
+}
+
+const int kGorderWindow = 5;
+
+/*
+  Both directions of the renaming: new_ids[original] and
+  orig_ids[relabeled]
+*/
+struct NodeOrder {
+  pvector<NodeID> new_ids;
+  pvector<NodeID> orig_ids;
+};
+
+int64_t TotalDegree(const WGraph &g, NodeID n)
+{
+  return g.directed() ? g.out_degree(n) + g.in_degree(n) : g.out_degree(n);
+}
+
+// Nodes (original IDs) in order of decreasing total degree
+std::vector<NodeID> DegreeSequence(const WGraph &g)
+{
+  std::vector<std::pair<int64_t, NodeID>> degree_node(g.num_nodes());
+  #pragma omp parallel for
+  for(NodeID n = 0; n < g.num_nodes(); ++n)
+    degree_node[n] = std::make_pair(-TotalDegree(g, n), n);
+  std::sort(degree_node.begin(), degree_node.end());
+  std::vector<NodeID> sequence(g.num_nodes());
+  for(NodeID n = 0; n < g.num_nodes(); ++n)
+    sequence[n] = degree_node[n].second;
+  return sequence;
+}
+
+/*
+  Cuthill-McKee: BFS over out- and in-neighbors from a minimum-degree
+  node of every component, visiting neighbors by increasing degree;
+  reversed at the end
+*/
+std::vector<NodeID> RCMSequence(const WGraph &g)
+{
+  std::vector<NodeID> by_degree = DegreeSequence(g);
+  std::reverse(by_degree.begin(), by_degree.end());
+  Bitmap visited(g.num_nodes());
+  visited.reset();
+  std::vector<NodeID> sequence;
+  sequence.reserve(g.num_nodes());
+  std::vector<std::pair<int64_t, NodeID>> frontier;
+  for(NodeID root : by_degree) {
+    if(visited.get_bit(root))
+      continue;
+    visited.set_bit(root);
+    size_t head = sequence.size();
+    sequence.push_back(root);
+    while(head < sequence.size()) {
+      NodeID u = sequence[head++];
+      frontier.clear();
+      for(auto v : g.out_neigh(u))
+        if(!visited.get_bit(v.v)) {
+          visited.set_bit(v.v);
+          frontier.emplace_back(TotalDegree(g, v.v), v.v);
+        }
+      if(g.directed())
+        for(auto v : g.in_neigh(u))
+          if(!visited.get_bit(v.v)) {
+            visited.set_bit(v.v);
+            frontier.emplace_back(TotalDegree(g, v.v), v.v);
+          }
+      std::sort(frontier.begin(), frontier.end());
+      for(auto &f : frontier)
+        sequence.push_back(f.second);
+    }
+  }
+  std::reverse(sequence.begin(), sequence.end());
+  return sequence;
+}
+
+/*
+  Max-priority queue over small integer keys with O(1) increment and
+  decrement (Gorder's unit heap): one doubly linked list per key
+*/
+class UnitHeap {
+ public:
+  explicit UnitHeap(int64_t n) : key_(n, 0), prev_(n), next_(n), in_heap_(n, true) {
+    head_.push_back(-1);
+    for(int64_t v = n - 1; v >= 0; --v)
+      Link(v, 0);
+  }
+
+  bool Contains(int64_t v) const { return in_heap_[v]; }
+  int64_t Key(int64_t v) const { return key_[v]; }
+
+  void Increment(int64_t v) {
+    Unlink(v);
+    Link(v, key_[v] + 1);
+  }
+
+  void Decrement(int64_t v) {
+    if(key_[v] == 0)
+      return;
+    Unlink(v);
+    Link(v, key_[v] - 1);
+  }
+
+  void Remove(int64_t v) {
+    Unlink(v);
+    in_heap_[v] = false;
+  }
+
+  // Node with the largest key; stays in the heap
+  int64_t Top() {
+    while(top_ > 0 && head_[top_] == -1)
+      top_--;
+    return head_[top_];
+  }
+
+ private:
+  std::vector<int64_t> key_, prev_, next_, head_;
+  std::vector<bool> in_heap_;
+  int64_t top_ = 0;
+
+  void Link(int64_t v, int64_t key) {
+    if(key >= (int64_t) head_.size())
+      head_.resize(key + 1, -1);
+    key_[v] = key;
+    prev_[v] = -1;
+    next_[v] = head_[key];
+    if(head_[key] != -1)
+      prev_[head_[key]] = v;
+    head_[key] = v;
+    top_ = std::max(top_, key);
+  }
+
+  void Unlink(int64_t v) {
+    if(prev_[v] != -1)
+      next_[prev_[v]] = next_[v];
+    else
+      head_[key_[v]] = next_[v];
+    if(next_[v] != -1)
+      prev_[next_[v]] = prev_[v];
+  }
+};
+
+/*
+  Greedy Gorder. Placing v raises the score of its out- and in-neighbors
+  and of its siblings (the other out-neighbors of its in-neighbors; on an
+  undirected graph in_neigh() is out_neigh()); the scores are lowered
+  again once v leaves the window. In-neighbors with more than sqrt(n)
+  out-edges are skipped for siblings, as in the paper, which bounds the
+  work on hubs. Takes the next highest-degree node whenever no node
+  scores (e.g., at the start).
+*/
+std::vector<NodeID> GorderSequence(const WGraph &g)
+{
+  int64_t n = g.num_nodes();
+  int64_t hub_degree = (int64_t) std::sqrt((double) n);
+  UnitHeap heap(n);
+  std::vector<NodeID> by_degree = DegreeSequence(g);
+  size_t next_seed = 0;
+  std::vector<NodeID> sequence;
+  sequence.reserve(n);
+
+  auto update = [&](NodeID v, bool increment) {
+    auto touch = [&](NodeID u) {
+      if(heap.Contains(u)) {
+        if(increment) heap.Increment(u);
+        else heap.Decrement(u);
+      }
+    };
+    for(auto u : g.out_neigh(v))
+      touch(u.v);
+    for(auto x : g.in_neigh(v)) {
+      touch(x.v);
+      if(g.out_degree(x.v) > hub_degree)
+        continue;
+      for(auto u : g.out_neigh(x.v))
+        if(u.v != v)
+          touch(u.v);
+    }
+  };
+
+  while((int64_t) sequence.size() < n) {
+    int64_t v = heap.Top();
+    // Nothing in the window scores: continue with the next hub
+    if(heap.Key(v) == 0) {
+      while(!heap.Contains(by_degree[next_seed]))
+        next_seed++;
+      v = by_degree[next_seed];
+    }
+    heap.Remove(v);
+    sequence.push_back(v);
+    update(v, true);
+    if((int64_t) sequence.size() > kGorderWindow)
+      update(sequence[sequence.size() - 1 - kGorderWindow], false);
+  }
+  return sequence;
+}
+
+/*
+  Computes the ordering and returns both directions of the renaming
+*/
+NodeOrder MakeNodeOrder(const WGraph &g, NodeOrdering ordering)
+{
+  Timer t;
+  t.Start();
+  std::vector<NodeID> sequence;
+  switch(ordering) {
+    case kOrderNone:
+      sequence.resize(g.num_nodes());
+      std::iota(sequence.begin(), sequence.end(), 0);
+      break;
+    case kOrderDegree:
+      sequence = DegreeSequence(g);
+      break;
+    case kOrderRCM:
+      sequence = RCMSequence(g);
+      break;
+    case kOrderGorder:
+      sequence = GorderSequence(g);
+      break;
+  }
+  NodeOrder order{pvector<NodeID>(g.num_nodes()), pvector<NodeID>(g.num_nodes())};
+  #pragma omp parallel for
+  for(NodeID i = 0; i < g.num_nodes(); ++i) {
+    order.orig_ids[i] = sequence[i];
+    order.new_ids[sequence[i]] = i;
+  }
+  t.Stop();
+  PrintStep("[TimingStat] Node ordering time (s):", t.Seconds());
+  return order;
+}
+
+/*
+  Average |u - v| over all edges, the locality the orderings improve
+*/
+double AverageEdgeGap(const WGraph &g)
+{
+  double gap = 0;
+  #pragma omp parallel for reduction(+:gap)
+  for(NodeID u = 0; u < g.num_nodes(); ++u)
+    for(auto v : g.out_neigh(u))
+      gap += std::abs((double) u - v.v);
+  return g.num_edges_directed() > 0 ? gap / g.num_edges_directed() : 0;
+}
@@ -5,6 +5,8 @@
 #include <mutex>
 std::mutex m_screen;
 
+#include "bitmap.h"
+
 /*
   Helper function to sort two temporal edges (TNode)
   in the increasing order of their timestamps
@@ -15,22 +17,21 @@ bool SortByTime(TNode n1, TNode n2)
 }
 
 /*
-  Filter a node's edges that have timestamps larger
-  than the incoming edge (i.e., src_time)
+  Generator of the walk engine; every random draw of the walks (start
+  times and next edges) comes from it. Every thread has its own, so the
+  walks never draw from the driver's rng, which other pipeline stages use
+  concurrently, and it is reseeded from the walks' base seed for every
+  chunk of walks, so a seed gives the same walks at any number of threads.
 */
-TempNodeVector FilterEdgesPostTime(
-  const WGraph &g, 
-  NodeID src_node, 
-  WeightT src_time) 
+static thread_local std::mt19937 walk_rng;
+
+// Start nodes of the per-node walks that share one seed
+const int64_t kNodeWalkChunk = 256;
+
+void SeedWalkChunk(uint64_t base_seed, int w_n, int64_t chunk)
 {
-  TempNodeVector filtered_edges;
-  for(auto v : g.out_neigh(src_node)) {
-    if(v.w > src_time)
-      filtered_edges.push_back(std::make_pair(v, v.w));
-  }
-  // Sort edges by timestamp?
-  //std::sort(filtered_edges.begin(), filtered_edges.end(), SortByTime);
-  return filtered_edges;
+  std::seed_seq seq{base_seed, (uint64_t) w_n, (uint64_t) chunk};
+  walk_rng.seed(seq);
 }
 
 /*
@@ -38,96 +39,288 @@ TempNodeVector FilterEdgesPostTime(
 */
 double RandomNumberGenerator() 
 {
-    static std::uniform_real_distribution<double> uid(0,1); 
-    return uid(rng);
+    static thread_local std::uniform_real_distribution<double> uid(0,1); 
+    return uid(walk_rng);
+}
+
+// Uniform index in [0, n)
+inline int64_t RandomIndex(int64_t n)
+{
+  return std::uniform_int_distribution<int64_t>(0, n - 1)(walk_rng);
 }
 
 /*
-  Function that returns a random neighbor to
-  walk based on the probability distribution
+  exp(x) for x in [-1, 0]: exp(-0.5) * exp(x + 0.5) with a degree-6
+  Taylor polynomial for the second factor (relative error < 3e-6).
+  Branch-free, so a loop over a neighborhood vectorizes.
 */
-int FindNeighborIdx(DoubleVector prob_dist) 
+#pragma omp declare simd
+inline float FastExpUnit(float x)
 {
-  /* 
-  Algorithm: get a random number between 0 and 1
-  calculate the CDF of probTimestamps and compare
-  against random number
-  */
-  double curCDF = 0, nextCDF = 0;
-  int cnt = 0;
-  double random_number = RandomNumberGenerator();
-  for(auto it : prob_dist) {
-      nextCDF += it;
-      if(nextCDF >= random_number && curCDF <= random_number) {
-          return cnt;
-      }  else {
-          curCDF = nextCDF;
-          cnt++;
-    }
+  float y = x + 0.5f;
+  float p = 1.0f / 720;
+  p = p * y + 1.0f / 120;
+  p = p * y + 1.0f / 24;
+  p = p * y + 1.0f / 6;
+  p = p * y + 0.5f;
+  p = p * y + 1.0f;
+  p = p * y + 1.0f;
+  return 0.60653066f * p;
+}
+
+// Temporal bias of the walks (walk_bias in the params file)
+enum WalkBias { kWalkUniform, kWalkLinear, kWalkExponential, kWalkRecent };
+
+WalkBias ParseWalkBias(std::string name)
+{
+  if(name == "uniform") return kWalkUniform;
+  if(name == "linear") return kWalkLinear;
+  if(name == "exponential") return kWalkExponential;
+  if(name == "recent") return kWalkRecent;
+  std::cout << "Unknown walk_bias " << name
+            << " (uniform, linear, exponential, recent)" << std::endl;
+  std::exit(-92);
+}
+
+/*
+  Views of a neighborhood for the walk engine: its edge times (indexable;
+  all the temporal filter and the bias weights read) and the edge at a
+  position. AoS over the WNode array of CSRGraph and the compressed CSR,
+  SoA over the separate arrays of SoATemporalCSR, where the times are
+  contiguous.
+*/
+struct AoSTimes {
+  const WNode *neigh;
+  WeightT operator[](int64_t i) const { return neigh[i].w; }
+};
+
+struct AoSNeighborhood {
+  int64_t size;
+  AoSTimes times;
+  TNode edge(int64_t i) const {
+    return std::make_pair(times.neigh[i].v, times.neigh[i].w);
   }
-  // Ideally, it should never hit this point
-  // The only time when it hits this is when the timestamps of all
-  //     outgoing edges are same, in which case, just randomly
-  //     selecting one edge out of all (as done below) should work.
-  return rand() % prob_dist.size();
+};
+
+struct SoANeighborhood {
+  int64_t size;
+  const WeightT *times;
+  const NodeID *dsts;
+  TNode edge(int64_t i) const { return std::make_pair(dsts[i], times[i]); }
+};
+
+template <typename GraphT>
+inline AoSNeighborhood NeighborhoodOf(const GraphT &g, NodeID n)
+{
+  auto neigh = g.out_neigh(n);
+  return {neigh.end() - neigh.begin(), {neigh.begin()}};
+}
+
+inline SoANeighborhood NeighborhoodOf(const SoATemporalCSR &g, NodeID n)
+{
+  return {g.out_degree(n), g.out_times(n), g.out_dests(n)};
 }
 
 /*
-  Function to compute the immediate next neighbor to walk
-  Builds a probability distribution based on the time difference
-  of incoming edge and outgoing edges
+  The edges of a neighborhood later than src_time. Neighborhoods are
+  sorted by time in every layout, so these are the suffix starting at
+  first: their number, the earliest later time and the time span of all
+  edges
 */
-bool GetNeighborToWalk(
-  const WGraph &g, 
-  NodeID src_node, 
+struct LaterEdges {
+  int64_t first = 0;
+  int64_t count = 0;
+  WeightT min_later = 0;
+  WeightT min_time = 0;
+  WeightT max_time = 0;
+};
+
+template <typename Times>
+inline LaterEdges FindLaterEdges(
+  const Times &times,
+  int64_t neighborhood_size,
+  WeightT src_time)
+{
+  // Binary search for the first edge later than src_time
+  int64_t lo = 0, hi = neighborhood_size;
+  while(lo < hi) {
+    int64_t mid = lo + (hi - lo) / 2;
+    if(times[mid] > src_time)
+      hi = mid;
+    else
+      lo = mid + 1;
+  }
+  LaterEdges later;
+  later.first = lo;
+  later.count = neighborhood_size - lo;
+  later.min_time = times[0];
+  later.max_time = times[neighborhood_size - 1];
+  if(later.count > 0)
+    later.min_later = times[later.first];
+  return later;
+}
+
+// Uniform pick among the later edges
+inline int64_t PickUniformLater(const LaterEdges &later)
+{
+  return later.first + RandomIndex(later.count);
+}
+
+/*
+  Draws a later edge with probability proportional to the weight that
+  WeightFn gives it, for weights of the form exp(x) with x in [-1, 0].
+  The weights of the later edges are computed in one SIMD pass and the
+  edge is found by scanning the running sum against a uniform draw
+  scaled by the total, so they are never normalized.
+*/
+template <typename WeightFn, typename Times>
+inline int64_t PickWeightedLater(
+  const Times &times,
+  const LaterEdges &later)
+{
+  static thread_local std::vector<float> weights;
+  if((int64_t) weights.size() < later.count)
+    weights.resize(later.count);
+  float *w = weights.data();
+  float inv_delta = 1.0f / (later.max_time - later.min_time);
+  float weight_sum = 0;
+  #pragma omp simd reduction(+:weight_sum)
+  for(int64_t i = 0; i < later.count; ++i) {
+    w[i] = FastExpUnit(WeightFn::Exponent(times[later.first + i], later, inv_delta));
+    weight_sum += w[i];
+  }
+  float target = RandomNumberGenerator() * weight_sum;
+  int64_t pick;
+  for(pick = 0; pick < later.count - 1; ++pick) {
+    target -= w[pick];
+    if(target < 0)
+      break;
+  }
+  return later.first + pick;
+}
+
+/*
+  Walk bias policies, the template parameter of the walk engine.
+  Next() draws the next edge of a walk at src_node among the edges later
+  than src_time and returns false if there is none.
+*/
+template <typename PickFn, typename GraphT>
+inline bool NextLaterEdge(
+  const GraphT &g,
+  NodeID src_node,
   WeightT src_time,
-  TNode& next_neighbor) 
+  TNode& next_neighbor)
 {
-  int neighborhood_size = g.out_degree(src_node);
-  if(neighborhood_size == 0) {
+  auto neigh = NeighborhoodOf(g, src_node);
+  if(neigh.size == 0)
     return false;
-  } else {
-    TempNodeVector filtered_edges = FilterEdgesPostTime(g, src_node, src_time);
-    if(filtered_edges.empty()) {
-      return false;
-    }
-    if(filtered_edges.size() == 1) {
-      next_neighbor = filtered_edges[0];
-      return true;
-    } else {
-      DoubleVector prob_dist;
-      WeightT time_boundary_diff;
-      time_boundary_diff = g.TimeBoundsDelta(src_node);
-      if(time_boundary_diff == 0)
-      {
-        next_neighbor = filtered_edges[rand() % filtered_edges.size()];
-        return true;
-      } else {
-        // TODO: parallelism?
-        for(auto it : filtered_edges) {
-          prob_dist.push_back(exp((float)(it.second-src_time)/time_boundary_diff));
-        }
-        double exp_sum = std::accumulate(prob_dist.begin(), prob_dist.end(), 0.0);
-        for (uint32_t i = 0; i < prob_dist.size(); ++i) {
-          prob_dist[i] = prob_dist[i] / exp_sum;
-        }
-        int neighbor_index = FindNeighborIdx(prob_dist);
-        next_neighbor = filtered_edges[neighbor_index];
-        return true;
-      }
-    }
-  }
+  LaterEdges later = FindLaterEdges(neigh.times, neigh.size, src_time);
+  if(later.count == 0)
+    return false;
+  int64_t pick = later.first;
+  if(later.count > 1)
+    pick = PickFn::Pick(neigh.times, later);
+  next_neighbor = neigh.edge(pick);
+  return true;
 }
 
+// Every later edge equally likely
+struct UniformWalk {
+  static const char* Name() { return "uniform"; }
+  template <typename Times>
+  static int64_t Pick(const Times &, const LaterEdges &later) {
+    return PickUniformLater(later);
+  }
+  template <typename GraphT>
+  static bool Next(const GraphT &g, NodeID src_node, WeightT src_time,
+                   TNode& next_neighbor) {
+    return NextLaterEdge<UniformWalk, GraphT>(g, src_node, src_time, next_neighbor);
+  }
+};
+
+/*
+  CTDNE linear bias: the m later edges are ranked by time, the earliest
+  with rank m and the latest with rank 1, and drawn proportional to their
+  rank. The rank is drawn by inverting its CDF; as the later edges are
+  in time order, the edge of rank r is the (m - r)-th of them.
+*/
+struct LinearWalk {
+  static const char* Name() { return "linear"; }
+  template <typename Times>
+  static int64_t Pick(const Times &, const LaterEdges &later) {
+    double m = later.count;
+    double target = RandomNumberGenerator() * m * (m + 1) / 2;
+    // Smallest rank r with r * (r + 1) / 2 > target
+    int64_t rank = (int64_t) ((std::sqrt(8 * target + 1) - 1) / 2) + 1;
+    rank = std::min<int64_t>(std::max<int64_t>(rank, 1), later.count);
+    return later.first + (later.count - rank);
+  }
+  template <typename GraphT>
+  static bool Next(const GraphT &g, NodeID src_node, WeightT src_time,
+                   TNode& next_neighbor) {
+    return NextLaterEdge<LinearWalk, GraphT>(g, src_node, src_time, next_neighbor);
+  }
+};
+
+/*
+  Exponential bias towards later edges: an edge at time t is drawn
+  proportional to exp((t - src_time) / delta), where delta is the time
+  span of the node's edges. Shifted by the node's latest time so every
+  exponent lies in [-1, 0]; this leaves the distribution unchanged and
+  cannot overflow. This is the original bias of the walks.
+*/
+struct ExponentialWalk {
+  static const char* Name() { return "exponential"; }
+  static float Exponent(WeightT t, const LaterEdges &later, float inv_delta) {
+    return (t - later.max_time) * inv_delta;
+  }
+  template <typename Times>
+  static int64_t Pick(const Times &times, const LaterEdges &later) {
+    if(later.max_time == later.min_time)
+      return PickUniformLater(later);
+    return PickWeightedLater<ExponentialWalk>(times, later);
+  }
+  template <typename GraphT>
+  static bool Next(const GraphT &g, NodeID src_node, WeightT src_time,
+                   TNode& next_neighbor) {
+    return NextLaterEdge<ExponentialWalk, GraphT>(g, src_node, src_time, next_neighbor);
+  }
+};
+
+/*
+  Softmax over recency: an edge at time t is drawn proportional to
+  exp(-(t - src_time) / delta), favoring the edges that follow src_time
+  most closely. Shifted by the earliest later time, so again every
+  exponent lies in [-1, 0].
+*/
+struct RecentWalk {
+  static const char* Name() { return "recent"; }
+  static float Exponent(WeightT t, const LaterEdges &later, float inv_delta) {
+    return (later.min_later - t) * inv_delta;
+  }
+  template <typename Times>
+  static int64_t Pick(const Times &times, const LaterEdges &later) {
+    if(later.max_time == later.min_time)
+      return PickUniformLater(later);
+    return PickWeightedLater<RecentWalk>(times, later);
+  }
+  template <typename GraphT>
+  static bool Next(const GraphT &g, NodeID src_node, WeightT src_time,
+                   TNode& next_neighbor) {
+    return NextLaterEdge<RecentWalk, GraphT>(g, src_node, src_time, next_neighbor);
+  }
+};
+
 /*
   Function to compute a random walk from a node.
   It recursively calls itself until either the maximum
   walk count has reached or if a node has no latent outgoing edges.
-  GetNeighborToWalk() function is used find the immediate 
+  WalkPolicy::Next() is used find the immediate 
   next neighbor to walk.
 */
+template <typename WalkPolicy, typename GraphT>
 bool compute_walk_from_a_node(
-  const WGraph& g, 
+  const GraphT& g, 
   NodeID src_node,
   WeightT prev_time_stamp, 
   TNode& next_neighbor_ret, 
@@ -136,8 +329,7 @@ bool compute_walk_from_a_node(
   int32_t pos) 
 {
   TNode next_neighbor;
-  if(g.out_degree(src_node) != 0 && 
-    GetNeighborToWalk(g, src_node, prev_time_stamp, next_neighbor)) {
+  if(WalkPolicy::Next(g, src_node, prev_time_stamp, next_neighbor)) {
     local_array[pos] = next_neighbor.first;
     next_neighbor_ret = next_neighbor;
     return true;
@@ -145,38 +337,162 @@ bool compute_walk_from_a_node(
   return false;
 }
 
+// Start time of the walks (walk_start_time in the params file)
+enum WalkStartTime { kStartZero, kStartEdge, kStartWindow, kStartMedian };
+
+WalkStartTime ParseWalkStartTime(std::string name)
+{
+  if(name == "zero") return kStartZero;
+  if(name == "edge") return kStartEdge;
+  if(name == "window") return kStartWindow;
+  if(name == "median") return kStartMedian;
+  std::cout << "Unknown walk_start_time " << name
+            << " (zero, edge, window, median)" << std::endl;
+  std::exit(-93);
+}
+
+/*
+  How walks pick their initial time; window_start is the start of the
+  sliding window for kStartWindow
+*/
+struct WalkStart {
+  WalkStartTime strategy = kStartZero;
+  WeightT window_start = 0;
+};
+
+/*
+  Start of the walk window: the latest fraction window of the graph's
+  time span
+*/
+template <typename GraphT>
+WalkStart MakeWalkStart(const GraphT &g, WalkStartTime strategy, float window)
+{
+  WalkStart start;
+  start.strategy = strategy;
+  if(strategy == kStartWindow) {
+    WeightT min_time = std::numeric_limits<WeightT>::max();
+    WeightT max_time = std::numeric_limits<WeightT>::lowest();
+    #pragma omp parallel for reduction(min:min_time) reduction(max:max_time)
+    for(NodeID n = 0; n < g.num_nodes(); ++n) {
+      for(auto v : g.out_neigh(n)) {
+        min_time = std::min(min_time, v.w);
+        max_time = std::max(max_time, v.w);
+      }
+    }
+    if(min_time <= max_time)
+      start.window_start = max_time - window * (max_time - min_time);
+    std::cout << "Walks start at time " << start.window_start << std::endl;
+  }
+  return start;
+}
+
 /*
   Function to return timestamp to initiate a random walk 
-  from a source node.
-  Currently it always returns 0, can be modified in the future.
+  from a source node. Walks only take edges later than it:
+  - zero: 0, every edge of the node can be the first hop
+  - edge: just before the time of a random edge of the node, so the
+    walk starts at that edge's time (CTDNE-style edge-start walks)
+  - window: the start of the sliding window (MakeWalkStart())
+  - median: just before the median time of the node's edges
 */
-WeightT GetInitialTime(const WGraph &g, NodeID src_node) 
+template <typename GraphT>
+WeightT GetInitialTime(const GraphT &g, NodeID src_node, const WalkStart &start) 
 {
-  // TODO: modify this function later
-  return (WeightT) 0;
+  int64_t degree = g.out_degree(src_node);
+  if(start.strategy == kStartZero || degree == 0)
+    return (WeightT) 0;
+  if(start.strategy == kStartWindow)
+    return start.window_start;
+  auto neigh = NeighborhoodOf(g, src_node);
+  WeightT t;
+  if(start.strategy == kStartEdge) {
+    t = neigh.times[RandomIndex(degree)];
+  } else {
+    static thread_local std::vector<WeightT> times;
+    times.resize(degree);
+    for(int64_t i = 0; i < degree; ++i)
+      times[i] = neigh.times[i];
+    std::nth_element(times.begin(), times.begin() + degree / 2, times.end());
+    t = times[degree / 2];
+  }
+  return std::nextafter(t, std::numeric_limits<WeightT>::lowest());
 }
 
 /*
-  Write random walk to a file
+  Temporal reach of every node, precomputed once per walk corpus so that
+  dead ends are detected in O(1) before touching a neighborhood:
+  - latest: the latest time of the node's outgoing edges (lowest() for
+    nodes without any), so a walk at the node at time t can go on only
+    if latest > t
+  - has_future: a walk started at the node takes at least one step, i.e.
+    it has an edge later than the earliest initial time of its walks
+    (0, the window start, or any edge for edge/median start times)
+*/
+class WalkReach {
+ public:
+  template <typename GraphT>
+  WalkReach(const GraphT &g, const WalkStart &start) :
+      latest_(g.num_nodes()), has_future_(g.num_nodes()) {
+    Timer t;
+    t.Start();
+    has_future_.reset();
+    WeightT bound = std::numeric_limits<WeightT>::lowest();
+    if(start.strategy == kStartZero)
+      bound = 0;
+    else if(start.strategy == kStartWindow)
+      bound = start.window_start;
+    int64_t num_reaching = 0;
+    #pragma omp parallel for reduction(+:num_reaching)
+    for(NodeID n = 0; n < g.num_nodes(); ++n) {
+      auto neigh = NeighborhoodOf(g, n);
+      WeightT latest = std::numeric_limits<WeightT>::lowest();
+      for(int64_t i = 0; i < neigh.size; ++i)
+        latest = std::max(latest, neigh.times[i]);
+      latest_[n] = latest;
+      if(neigh.size > 0 && latest > bound) {
+        has_future_.set_bit_atomic(n);
+        num_reaching++;
+      }
+    }
+    std::cout << num_reaching << " of " << g.num_nodes()
+              << " nodes can start a temporal walk" << std::endl;
+    t.Stop();
+    PrintStep("[TimingStat] Walk reach time (s):", t.Seconds());
+  }
+
+  bool DeadEnd(NodeID n, WeightT time) const { return latest_[n] <= time; }
+  bool HasFuture(NodeID n) const { return has_future_.get_bit(n); }
+
+ private:
+  pvector<WeightT> latest_;
+  Bitmap has_future_;
+};
+
+/*
+  Write random walk to a file.
+  Walks computed on a relabeled graph (reorder.h) are written in the
+  order and with the IDs of the original graph.
 */
 void WriteWalkToAFile(
   NodeID* global_walk, 
-  int num_nodes, 
+  int64_t num_nodes, 
   int max_walk,
   int num_walks_per_node,
-  std::string walk_filename) 
+  std::string walk_filename,
+  const NodeOrder *order = nullptr) 
 {
   std::ofstream random_walk_file(walk_filename);
   for(int w_n = 0; w_n < num_walks_per_node; ++w_n) {
-    for(NodeID iter = 0; iter < num_nodes; iter++) {
+    for(int64_t iter = 0; iter < num_nodes; iter++) {
+      int64_t row = order ? order->new_ids[iter] : iter;
       NodeID *local_walk = 
         global_walk + 
-        ( iter * max_walk * num_walks_per_node ) +
+        ( row * max_walk * num_walks_per_node ) +
         ( w_n * max_walk );
       for (int i = 0; i < max_walk; i++) {
           if (local_walk[i] == -1)
             break;
-          random_walk_file << local_walk[i] << " ";
+          random_walk_file << (order ? order->orig_ids[local_walk[i]] : local_walk[i]) << " ";
       }
       random_walk_file << "\n";
     }
@@ -184,56 +500,587 @@ void WriteWalkToAFile(
   random_walk_file.close();
 }
 
+/*
+  Extends a walk whose entry walk_cnt - 1 is node, reached at time
+  prev_time_stamp, until it has max_walk_length entries or no later edge
+  is left; the latter is checked against reach before every step.
+  A walk shorter than max_walk_length is terminated with -1.
+*/
+template <typename WalkPolicy, typename GraphT>
+void continue_walk(
+  const GraphT &g,
+  NodeID node,
+  WeightT prev_time_stamp,
+  int walk_cnt,
+  int max_walk_length,
+  const WalkReach &reach,
+  NodeID *local_walk)
+{
+  NodeID next_neighbor = node;
+  TNode next_neighbor_ret;
+  for(; walk_cnt < max_walk_length; ++walk_cnt) {
+    if(reach.DeadEnd(next_neighbor, prev_time_stamp))
+      break;
+    bool cont = compute_walk_from_a_node<WalkPolicy>(
+      g, 
+      next_neighbor, 
+      prev_time_stamp, 
+      next_neighbor_ret, 
+      max_walk_length, 
+      local_walk, 
+      walk_cnt
+    );
+    if(!cont) break;
+    next_neighbor = next_neighbor_ret.first;
+    prev_time_stamp = next_neighbor_ret.second;
+  }
+  if (walk_cnt != max_walk_length)
+      local_walk[walk_cnt] = -1;
+}
+
+/*
+  Computes one temporal walk starting at src_node into local_walk,
+  which has room for max_walk_length entries (including src_node).
+  A walk shorter than max_walk_length is terminated with -1.
+  Nodes without temporal reach get the single-node walk right away.
+*/
+template <typename WalkPolicy, typename GraphT>
+void compute_single_walk(
+  const GraphT &g,
+  NodeID src_node,
+  int max_walk_length,
+  const WalkStart &start,
+  const WalkReach &reach,
+  NodeID *local_walk)
+{
+  local_walk[0] = src_node;
+  if(!reach.HasFuture(src_node)) {
+    if(max_walk_length > 1)
+      local_walk[1] = -1;
+    return;
+  }
+  continue_walk<WalkPolicy>(g, src_node, GetInitialTime(g, src_node, start),
+                            1, max_walk_length, reach, local_walk);
+}
+
+/*
+  Reports the walk throughput of a policy, steps (edges traversed)
+  per second over all walks in global_walk, and the histogram of the
+  walk lengths (in nodes)
+*/
+template <typename WalkPolicy>
+void PrintWalkThroughput(
+  const NodeID *global_walk,
+  int64_t num_walks,
+  int max_walk,
+  double seconds)
+{
+  std::vector<int64_t> histogram(max_walk + 1, 0);
+  #pragma omp parallel
+  {
+    std::vector<int64_t> local_histogram(max_walk + 1, 0);
+    #pragma omp for nowait
+    for(int64_t w = 0; w < num_walks; ++w) {
+      const NodeID *walk = global_walk + w * max_walk;
+      int len = 0;
+      while(len < max_walk && walk[len] != -1)
+        len++;
+      local_histogram[len]++;
+    }
+    #pragma omp critical
+    for(int len = 0; len <= max_walk; ++len)
+      histogram[len] += local_histogram[len];
+  }
+  int64_t num_steps = 0;
+  for(int len = 1; len <= max_walk; ++len)
+    num_steps += histogram[len] * (len - 1);
+  PrintStep(std::string("[TimingStat] Walk steps per second (") +
+            WalkPolicy::Name() + ")",
+            (int64_t) (seconds > 0 ? num_steps / seconds : 0));
+  std::cout << "Walk length histogram (nodes: walks):" << std::endl;
+  for(int len = 1; len <= max_walk; ++len) {
+    if(histogram[len] == 0)
+      continue;
+    printf("  %3d: %12" PRId64 " (%5.1f%%)\n", len, histogram[len],
+           100.0 * histogram[len] / num_walks);
+  }
+}
+
 /*
   Function that iterates over all vertices in graph,
   and calls compute_walk_from_a_node() function.
   Each random walk from a node is stored in local_walk,
-  which is pushed to global_walk that stores all random walks
+  which is pushed to global_walk that stores all random walks.
+  The walk bias is the WalkPolicy template parameter, so each policy
+  gets its own inlined hot loop.
 */
+template <typename WalkPolicy, typename GraphT>
 void compute_random_walk(
-  const WGraph &g, 
+  const GraphT &g, 
   int max_walk_length,
   int num_walks_per_node,
-  std::string walk_filename) {
+  std::string walk_filename,
+  const WalkStart &start,
+  uint64_t base_seed,
+  const NodeOrder *order = nullptr) {
   std::cout << "Computing random walk for " << g.num_nodes() << " nodes and " 
       << g.num_edges() << " edges." << std::endl;
   max_walk_length++;
   NodeID *global_walk = new NodeID[g.num_nodes() * max_walk_length * num_walks_per_node];
+  WalkReach reach(g, start);
   Timer t;
   t.Start();
+  int64_t num_chunks = (g.num_nodes() + kNodeWalkChunk - 1) / kNodeWalkChunk;
   for(int w_n = 0; w_n < num_walks_per_node; ++w_n) {
     std::cout << "walk number: " << w_n << std::endl;
-    parallel_for(NodeID i = 0; i < g.num_nodes(); ++i) {
-      NodeID *local_walk = 
-        global_walk + 
-        ( i * max_walk_length * num_walks_per_node ) +
-        ( w_n * max_walk_length );
-      local_walk[0] = i;
-      WeightT prev_time_stamp = 0;
-      NodeID next_neighbor = i;
-      TNode next_neighbor_ret;
-      int walk_cnt;
-      for(walk_cnt = 1; walk_cnt < max_walk_length; ++walk_cnt) {
-        bool cont = compute_walk_from_a_node(
-          g, 
-          next_neighbor, 
-          prev_time_stamp, 
-          next_neighbor_ret, 
-          max_walk_length, 
-          local_walk, 
-          walk_cnt
-        );
-        if(!cont) break;
-        next_neighbor = next_neighbor_ret.first;
-        prev_time_stamp = next_neighbor_ret.second;
+    parallel_for(int64_t c = 0; c < num_chunks; ++c) {
+      SeedWalkChunk(base_seed, w_n, c);
+      NodeID end = std::min<int64_t>(g.num_nodes(), (c + 1) * kNodeWalkChunk);
+      for(NodeID i = c * kNodeWalkChunk; i < end; ++i) {
+        NodeID *local_walk = 
+          global_walk + 
+          ( (int64_t) i * max_walk_length * num_walks_per_node ) +
+          ( w_n * max_walk_length );
+        compute_single_walk<WalkPolicy>(g, i, max_walk_length, start, reach, local_walk);
       }
-      if (walk_cnt != max_walk_length)
-          local_walk[walk_cnt] = -1;
     }
   }
   t.Stop();
   PrintStep("[TimingStat] Random walk time (s):", t.Seconds());
+  PrintWalkThroughput<WalkPolicy>(global_walk,
+    g.num_nodes() * num_walks_per_node, max_walk_length, t.Seconds());
   WriteWalkToAFile(global_walk, g.num_nodes(), 
+    max_walk_length, num_walks_per_node, walk_filename, order);
+  delete[] global_walk;
+}
+
+/*
+  Finds the start nodes of an incremental walk for newly arrived edges:
+  the endpoints of every delta edge plus the in-neighbors of its source
+  that reach it in time (their edge into the source is older than the
+  delta edge), i.e., the nodes whose temporal walks can now change.
+*/
+std::vector<NodeID> FindDeltaWalkSources(
+  const WGraph &g,
+  const EdgeList &delta_el)
+{
+  Bitmap touched(g.num_nodes());
+  touched.reset();
+  parallel_for(size_t e = 0; e < delta_el.size(); ++e) {
+    NodeID u = delta_el[e].u;
+    NodeID v = delta_el[e].v.v;
+    WeightT t = delta_el[e].v.w;
+    touched.set_bit_atomic(u);
+    touched.set_bit_atomic(v);
+    for(auto in : g.in_neigh(u)) {
+      if(in.w < t)
+        touched.set_bit_atomic(in.v);
+    }
+  }
+  std::vector<NodeID> sources;
+  for(NodeID n = 0; n < g.num_nodes(); ++n) {
+    if(touched.get_bit(n))
+      sources.push_back(n);
+  }
+  return sources;
+}
+
+/*
+  Same as compute_random_walk(), but only starts walks from the given
+  source nodes (see FindDeltaWalkSources()), so the cost of refreshing
+  the walk corpus scales with the delta instead of the whole graph.
+*/
+template <typename WalkPolicy, typename GraphT>
+void compute_random_walk_from_sources(
+  const GraphT &g, 
+  const std::vector<NodeID> &sources,
+  int max_walk_length,
+  int num_walks_per_node,
+  std::string walk_filename,
+  const WalkStart &start,
+  uint64_t base_seed) {
+  int64_t num_sources = sources.size();
+  std::cout << "Computing random walk for " << num_sources << " of " 
+      << g.num_nodes() << " nodes." << std::endl;
+  max_walk_length++;
+  NodeID *global_walk = new NodeID[num_sources * max_walk_length * num_walks_per_node];
+  WalkReach reach(g, start);
+  Timer t;
+  t.Start();
+  int64_t num_chunks = (num_sources + kNodeWalkChunk - 1) / kNodeWalkChunk;
+  for(int w_n = 0; w_n < num_walks_per_node; ++w_n) {
+    parallel_for(int64_t c = 0; c < num_chunks; ++c) {
+      SeedWalkChunk(base_seed, w_n, c);
+      int64_t end = std::min(num_sources, (c + 1) * kNodeWalkChunk);
+      for(int64_t i = c * kNodeWalkChunk; i < end; ++i) {
+        NodeID *local_walk = 
+          global_walk + 
+          ( i * max_walk_length * num_walks_per_node ) +
+          ( w_n * max_walk_length );
+        compute_single_walk<WalkPolicy>(g, sources[i], max_walk_length, start, reach, local_walk);
+      }
+    }
+  }
+  t.Stop();
+  PrintStep("[TimingStat] Random walk time (s):", t.Seconds());
+  PrintWalkThroughput<WalkPolicy>(global_walk,
+    num_sources * num_walks_per_node, max_walk_length, t.Seconds());
+  WriteWalkToAFile(global_walk, num_sources, 
     max_walk_length, num_walks_per_node, walk_filename);
   delete[] global_walk;
-}
\ No newline at end of file
+}
+
+// Bias of the initial edges of edge-start walks (edge_walk_bias)
+enum EdgeStartBias { kEdgeUniform, kEdgeLinear, kEdgeExponential };
+
+EdgeStartBias ParseEdgeStartBias(std::string name)
+{
+  if(name == "uniform") return kEdgeUniform;
+  if(name == "linear") return kEdgeLinear;
+  if(name == "exponential") return kEdgeExponential;
+  std::cout << "Unknown edge_walk_bias " << name
+            << " (uniform, linear, exponential)" << std::endl;
+  std::exit(-94);
+}
+
+struct TemporalEdge {
+  NodeID src;
+  NodeID dst;
+  WeightT time;
+};
+
+/*
+  All edges of the graph sorted by time, with a sampler of initial edges
+  for edge-start walks. Uniform draws are O(1); the time-biased draws
+  search the prefix sums of the edge weights (O(log m)):
+  - linear: proportional to the edge's rank in time (latest = m)
+  - exponential: proportional to exp((t - t_max) / span)
+*/
+class TimeSortedEdges {
+ public:
+  template <typename GraphT>
+  TimeSortedEdges(const GraphT &g, EdgeStartBias bias) : bias_(bias) {
+    Timer t;
+    t.Start();
+    edges_.resize(g.num_edges_directed());
+    pvector<SGOffset> offsets(g.num_nodes() + 1);
+    parallel_for(NodeID n = 0; n < g.num_nodes(); ++n)
+      offsets[n] = g.out_degree(n);
+    ParallelScan(offsets.data(), g.num_nodes(), offsets.data());
+    parallel_for(NodeID n = 0; n < g.num_nodes(); ++n) {
+      int64_t e = offsets[n];
+      for(auto v : g.out_neigh(n))
+        edges_[e++] = {n, v.v, v.w};
+    }
+    std::sort(edges_.begin(), edges_.end(),
+      [](const TemporalEdge &a, const TemporalEdge &b) { return a.time < b.time; });
+
+    if(bias_ != kEdgeUniform && !edges_.empty()) {
+      WeightT min_time = edges_.front().time, max_time = edges_.back().time;
+      float inv_span = (max_time > min_time) ? 1.0f / (max_time - min_time) : 0.0f;
+      std::vector<double> weights(edges_.size());
+      parallel_for(size_t e = 0; e < edges_.size(); ++e)
+        weights[e] = (bias_ == kEdgeLinear) ? (double) (e + 1) :
+          FastExpUnit((edges_[e].time - max_time) * inv_span);
+      prefix_.resize(edges_.size() + 1);
+      ParallelScan(weights.data(), weights.size(), prefix_.data());
+    }
+    t.Stop();
+    PrintStep("[TimingStat] Edge sort time (s):", t.Seconds());
+  }
+
+  size_t size() const { return edges_.size(); }
+
+  const TemporalEdge& Sample(std::mt19937 &gen) const {
+    if(bias_ == kEdgeUniform)
+      return edges_[std::uniform_int_distribution<size_t>(0, edges_.size() - 1)(gen)];
+    double target = std::uniform_real_distribution<double>(0, prefix_.back())(gen);
+    size_t e = std::upper_bound(prefix_.begin() + 1, prefix_.end(), target) - (prefix_.begin() + 1);
+    return edges_[std::min(e, edges_.size() - 1)];
+  }
+
+ private:
+  EdgeStartBias bias_;
+  std::vector<TemporalEdge> edges_;
+  std::vector<double> prefix_;
+};
+
+// Walks of an edge-start corpus that share one generator
+const int64_t kEdgeWalkChunk = 1024;
+
+/*
+  Edge-start (CTDNE-style) walk engine: every walk starts with an
+  initial edge drawn from the time-sorted edge list and walks forward in
+  time from its destination. Parallel over walks instead of nodes, and
+  the corpus size is num_walks, independent of the number of nodes, so
+  no walks are wasted on nodes without (later) edges.
+*/
+template <typename WalkPolicy, typename GraphT>
+void compute_edge_walks(
+  const GraphT &g,
+  const TimeSortedEdges &edges,
+  int max_walk_length,
+  int64_t num_walks,
+  std::string walk_filename,
+  uint64_t base_seed) {
+  std::cout << "Computing " << num_walks << " edge-start walks over "
+      << edges.size() << " edges." << std::endl;
+  max_walk_length++;
+  NodeID *global_walk = new NodeID[num_walks * max_walk_length];
+  WalkReach reach(g, WalkStart());
+  Timer t;
+  t.Start();
+  int64_t num_chunks = (num_walks + kEdgeWalkChunk - 1) / kEdgeWalkChunk;
+  #pragma omp parallel for schedule(dynamic)
+  for(int64_t c = 0; c < num_chunks; ++c) {
+    std::seed_seq seq{base_seed, (uint64_t) c};
+    walk_rng.seed(seq);
+    int64_t end = std::min(num_walks, (c + 1) * kEdgeWalkChunk);
+    for(int64_t w = c * kEdgeWalkChunk; w < end; ++w) {
+      NodeID *local_walk = global_walk + w * max_walk_length;
+      const TemporalEdge &e = edges.Sample(walk_rng);
+      local_walk[0] = e.src;
+      if(max_walk_length < 2)
+        continue;
+      local_walk[1] = e.dst;
+      continue_walk<WalkPolicy>(g, e.dst, e.time, 2, max_walk_length, reach, local_walk);
+    }
+  }
+  t.Stop();
+  PrintStep("[TimingStat] Random walk time (s):", t.Seconds());
+  PrintWalkThroughput<WalkPolicy>(global_walk, num_walks, max_walk_length, t.Seconds());
+  WriteWalkToAFile(global_walk, num_walks, max_walk_length, 1, walk_filename);
+  delete[] global_walk;
+}
+
+/*
+  Runs the walk engine specialized for the given bias
+*/
+template <typename GraphT>
+void compute_random_walk(
+  const GraphT &g, 
+  int max_walk_length,
+  int num_walks_per_node,
+  std::string walk_filename,
+  WalkBias bias,
+  const WalkStart &start,
+  uint64_t base_seed,
+  const NodeOrder *order = nullptr) {
+  switch(bias) {
+    case kWalkUniform:
+      compute_random_walk<UniformWalk>(g, max_walk_length, num_walks_per_node, walk_filename, start, base_seed, order);
+      break;
+    case kWalkLinear:
+      compute_random_walk<LinearWalk>(g, max_walk_length, num_walks_per_node, walk_filename, start, base_seed, order);
+      break;
+    case kWalkExponential:
+      compute_random_walk<ExponentialWalk>(g, max_walk_length, num_walks_per_node, walk_filename, start, base_seed, order);
+      break;
+    case kWalkRecent:
+      compute_random_walk<RecentWalk>(g, max_walk_length, num_walks_per_node, walk_filename, start, base_seed, order);
+      break;
+  }
+}
+
+// Graph layout the per-node walks run on (walk_layout in the params file)
+enum WalkLayout { kLayoutCSR, kLayoutSoA, kLayoutCompressed };
+
+WalkLayout ParseWalkLayout(std::string name)
+{
+  if(name == "csr") return kLayoutCSR;
+  if(name == "soa") return kLayoutSoA;
+  if(name == "compressed") return kLayoutCompressed;
+  std::cout << "Unknown walk_layout " << name
+            << " (csr, soa, compressed)" << std::endl;
+  std::exit(-95);
+}
+
+/*
+  Time window of the walks (walk_time_window): "all", "train" (the edges
+  before train_end, the first test edge of link prediction; not
+  available if train_end is null) or "t0,t1" for t0 <= time < t1
+*/
+TimeWindow ParseTimeWindow(std::string spec, const WeightT *train_end)
+{
+  TimeWindow window;
+  if(spec == "all")
+    return window;
+  if(spec == "train" && train_end != nullptr) {
+    window.end = *train_end;
+    return window;
+  }
+  size_t comma = spec.find(',');
+  if(spec != "train" && comma != std::string::npos) {
+    window.start = std::stof(spec.substr(0, comma));
+    window.end = std::stof(spec.substr(comma + 1));
+    if(window.start < window.end)
+      return window;
+  }
+  std::cout << "Invalid walk_time_window " << spec << " (all, "
+            << (train_end != nullptr ? "train, " : "") << "t0,t1 with t0 < t1)"
+            << std::endl;
+  std::exit(-97);
+}
+
+// Calls f with g, or with the view of g's edges in window
+template <typename F>
+void WithTimeWindow(const WGraph &g, const TimeWindow &window, F f)
+{
+  if(window.all())
+    f(g);
+  else
+    f(TimeWindowView(g, window));
+}
+
+/*
+  Runs the per-node walks on the CSR itself or on a SoA or compressed
+  copy of it (temporal_csr.h) built for the walks. g is relabeled by
+  order (reorder.h), whose walks are written with the original IDs, or
+  has the original IDs if order is null. The walks only take edges in
+  window and are seeded from gen, a generator owned by the calling stage.
+*/
+void compute_random_walk_on_layout(
+  const WGraph &g,
+  const NodeOrder *order,
+  WalkLayout layout,
+  double time_resolution,
+  int max_walk_length,
+  int num_walks_per_node,
+  std::string walk_filename,
+  WalkBias bias,
+  const WalkStart &start,
+  std::mt19937 &gen,
+  const TimeWindow &window = TimeWindow()) {
+  uint64_t base_seed = gen();
+  WithTimeWindow(g, window, [&](const auto &view) {
+    switch(layout) {
+      case kLayoutCSR:
+        compute_random_walk(view, max_walk_length, num_walks_per_node,
+                            walk_filename, bias, start, base_seed, order);
+        break;
+      case kLayoutSoA:
+        compute_random_walk(SoATemporalCSR(view), max_walk_length,
+                            num_walks_per_node, walk_filename, bias, start,
+                            base_seed, order);
+        break;
+      case kLayoutCompressed:
+        compute_random_walk(CompressedTemporalCSR(view, time_resolution),
+                            max_walk_length, num_walks_per_node,
+                            walk_filename, bias, start, base_seed, order);
+        break;
+    }
+  });
+}
+
+// Relabeled copy of g for the walks of an ordering other than kOrderNone
+WGraph RelabelForWalks(const WGraph &g, const NodeOrder &order)
+{
+  WGraph relabeled = WeightedBuilder::RelabelByMapping(g, order.new_ids);
+  std::cout << "Average edge gap: " << AverageEdgeGap(g) << " (original), "
+            << AverageEdgeGap(relabeled) << " (relabeled)" << std::endl;
+  return relabeled;
+}
+
+/*
+  Same, on g with the original IDs: with an ordering other than
+  kOrderNone the walks run on a relabeled copy of g
+*/
+void compute_random_walk_on_layout(
+  const WGraph &g,
+  WalkLayout layout,
+  NodeOrdering ordering,
+  double time_resolution,
+  int max_walk_length,
+  int num_walks_per_node,
+  std::string walk_filename,
+  WalkBias bias,
+  const WalkStart &start,
+  std::mt19937 &gen,
+  const TimeWindow &window = TimeWindow()) {
+  if(ordering == kOrderNone) {
+    compute_random_walk_on_layout(g, nullptr, layout, time_resolution,
+                                  max_walk_length, num_walks_per_node,
+                                  walk_filename, bias, start, gen, window);
+    return;
+  }
+  NodeOrder order = MakeNodeOrder(g, ordering);
+  WGraph relabeled = RelabelForWalks(g, order);
+  compute_random_walk_on_layout(relabeled, &order, layout, time_resolution,
+                                max_walk_length, num_walks_per_node,
+                                walk_filename, bias, start, gen, window);
+}
+
+void compute_random_walk_from_sources(
+  const WGraph &g, 
+  const std::vector<NodeID> &sources,
+  int max_walk_length,
+  int num_walks_per_node,
+  std::string walk_filename,
+  WalkBias bias,
+  const WalkStart &start,
+  std::mt19937 &gen,
+  const TimeWindow &window = TimeWindow()) {
+  uint64_t base_seed = gen();
+  WithTimeWindow(g, window, [&](const auto &view) {
+    switch(bias) {
+      case kWalkUniform:
+        compute_random_walk_from_sources<UniformWalk>(
+          view, sources, max_walk_length, num_walks_per_node, walk_filename, start,
+          base_seed);
+        break;
+      case kWalkLinear:
+        compute_random_walk_from_sources<LinearWalk>(
+          view, sources, max_walk_length, num_walks_per_node, walk_filename, start,
+          base_seed);
+        break;
+      case kWalkExponential:
+        compute_random_walk_from_sources<ExponentialWalk>(
+          view, sources, max_walk_length, num_walks_per_node, walk_filename, start,
+          base_seed);
+        break;
+      case kWalkRecent:
+        compute_random_walk_from_sources<RecentWalk>(
+          view, sources, max_walk_length, num_walks_per_node, walk_filename, start,
+          base_seed);
+        break;
+    }
+  });
+}
+
+// Edge-start walks in window, seeded from gen like the per-node walks
+void compute_edge_walks(
+  const WGraph &g,
+  int max_walk_length,
+  int64_t num_walks,
+  std::string walk_filename,
+  WalkBias bias,
+  EdgeStartBias edge_bias,
+  std::mt19937 &gen,
+  const TimeWindow &window = TimeWindow()) {
+  uint64_t base_seed = gen();
+  WithTimeWindow(g, window, [&](const auto &view) {
+    if(view.num_edges() == 0) {
+      WriteWalkToAFile(nullptr, 0, max_walk_length + 1, 1, walk_filename);
+      return;
+    }
+    TimeSortedEdges edges(view, edge_bias);
+    switch(bias) {
+      case kWalkUniform:
+        compute_edge_walks<UniformWalk>(
+          view, edges, max_walk_length, num_walks, walk_filename, base_seed);
+        break;
+      case kWalkLinear:
+        compute_edge_walks<LinearWalk>(
+          view, edges, max_walk_length, num_walks, walk_filename, base_seed);
+        break;
+      case kWalkExponential:
+        compute_edge_walks<ExponentialWalk>(
+          view, edges, max_walk_length, num_walks, walk_filename, base_seed);
+        break;
+      case kWalkRecent:
+        compute_edge_walks<RecentWalk>(
+          view, edges, max_walk_length, num_walks, walk_filename, base_seed);
+        break;
+    }
+  });
+}
@@ -58,6 +58,8 @@ bool print_datasets = false;
 #define parallel_for for
 #endif
 
+#include "temporal_csr.h"
+#include "reorder.h"
 #include "rwalk.h"
 
 /*
@@ -88,6 +90,11 @@ int main(int argc, char* argv[]) {
   // Read parameter configuration file
   cli.read_params_file();
 
+  // Temporal squish of the graph before walking
+  if(cli.get_dedup_edges() || cli.get_keep_last_k() > 0)
+    g = WeightedBuilder::SquishTemporalGraph(g, cli.get_dedup_edges(),
+                                             cli.get_keep_last_k());
+
   // Parameter initialization
   int   max_walk_length     =   cli.get_max_walk_length();
   float ratio               =   cli.get_training_ratio();
@@ -102,15 +109,48 @@ int main(int argc, char* argv[]) {
 
   omp_set_num_threads(48);
 
+  WalkStart walk_start = MakeWalkStart(g,
+    ParseWalkStartTime(cli.get_walk_start_time()), cli.get_walk_window());
+  TimeWindow walk_window = ParseTimeWindow(cli.get_walk_time_window(), nullptr);
+
+  // walk_bias all benchmarks every bias policy in turn
+  std::vector<WalkBias> biases;
+  if(cli.get_walk_bias() == "all")
+    biases = {kWalkUniform, kWalkLinear, kWalkExponential, kWalkRecent};
+  else
+    biases = {ParseWalkBias(cli.get_walk_bias())};
+
   // Compute temporal random walk
-  for(int i=0; i<20; ++i) {
-    // std::cout << "\n---- RWALK ----\n";
-    compute_random_walk(
-      /* temporal graph */ g, 
-      /* max random walk length */ max_walk_length,
-      /* number of rwalks/node */ num_walks_per_node,
-      /* filename of random walk */ "out_random_walk.txt"
-    );
+  for(WalkBias bias : biases) {
+    for(int i=0; i<20; ++i) {
+      // std::cout << "\n---- RWALK ----\n";
+      if(cli.get_num_edge_walks() > 0) {
+        compute_edge_walks(
+          /* temporal graph */ g, 
+          /* max random walk length */ max_walk_length,
+          /* number of rwalks in total */ cli.get_num_edge_walks(),
+          /* filename of random walk */ "out_random_walk.txt",
+          /* temporal bias of the walks */ bias,
+          /* bias of the initial edges */ ParseEdgeStartBias(cli.get_edge_walk_bias()),
+          /* generator of the walks */ rng,
+          /* time window of the walked edges */ walk_window
+        );
+        continue;
+      }
+      compute_random_walk_on_layout(
+        /* temporal graph */ g, 
+        /* graph layout of the walks */ ParseWalkLayout(cli.get_walk_layout()),
+        /* node ordering of the walks */ ParseNodeOrdering(cli.get_walk_order()),
+        /* time quantum of the compressed layout */ cli.get_csr_time_resolution(),
+        /* max random walk length */ max_walk_length,
+        /* number of rwalks/node */ num_walks_per_node,
+        /* filename of random walk */ "out_random_walk.txt",
+        /* temporal bias of the walks */ bias,
+        /* initial time of the walks */ walk_start,
+        /* generator of the walks */ rng,
+        /* time window of the walked edges */ walk_window
+      );
+    }
   }
 
   return 0;
@@ -0,0 +1,95 @@
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <vector>
+#include <stdio.h>
+#include <stdlib.h>
+#include <random>
+
+#include "benchmark.h"
+#include "pvector.h"
+#include "timer.h"
+#include "util.h"
+
+#if defined(OPENMP)
+#include <omp.h>
+#endif
+
+/*
+  Prefix-sum microbenchmark.
+  Times ParallelScan (util.h) over an array of random degrees against a
+  serial scan with 1, 2, 4, ... threads up to max_threads, the way the
+  builder computes vertex offsets, and checks the offsets agree.
+  Input arguments
+  @ num_elements (default 2^27)
+  @ max_threads (default all threads)
+  @ repetitions (default 5, the best time is reported)
+*/
+
+int main(int argc, char* argv[]) {
+
+  int64_t num_elements = (argc > 1) ? atoll(argv[1]) : (int64_t) 1 << 27;
+  int max_threads = 1;
+#if defined(OPENMP)
+  max_threads = omp_get_max_threads();
+#endif
+  if (argc > 2)
+    max_threads = atoi(argv[2]);
+  int repetitions = (argc > 3) ? atoi(argv[3]) : 5;
+
+  pvector<NodeID> degrees(num_elements);
+  std::mt19937 gen(kRandSeed);
+  std::uniform_int_distribution<int> dist(0, 64);
+  for (int64_t i = 0; i < num_elements; i++)
+    degrees[i] = dist(gen);
+
+  pvector<SGOffset> serial(num_elements + 1);
+  double serial_time = 1e30;
+  for (int r = 0; r < repetitions; r++) {
+    Timer t;
+    t.Start();
+    SGOffset total = 0;
+    for (int64_t i = 0; i < num_elements; i++) {
+      serial[i] = total;
+      total += degrees[i];
+    }
+    serial[num_elements] = total;
+    t.Stop();
+    serial_time = std::min(serial_time, t.Seconds());
+  }
+  std::cout << "Scanning " << num_elements << " elements" << std::endl;
+  PrintTime("Serial scan", serial_time);
+
+  std::vector<int> thread_counts;
+  for (int threads = 1; threads < max_threads; threads *= 2)
+    thread_counts.push_back(threads);
+  thread_counts.push_back(max_threads);
+
+  pvector<SGOffset> offsets(num_elements + 1);
+  for (int threads : thread_counts) {
+#if defined(OPENMP)
+    omp_set_num_threads(threads);
+#endif
+    double best = 1e30;
+    for (int r = 0; r < repetitions; r++) {
+      Timer t;
+      t.Start();
+      ParallelScan(degrees.data(), num_elements, offsets.data());
+      t.Stop();
+      best = std::min(best, t.Seconds());
+    }
+    int64_t mismatches = 0;
+    #pragma omp parallel for reduction(+:mismatches)
+    for (int64_t i = 0; i <= num_elements; i++)
+      mismatches += (offsets[i] != serial[i]);
+    if (mismatches != 0) {
+      std::cout << "ParallelScan differs from the serial scan in "
+                << mismatches << " offsets" << std::endl;
+      return -1;
+    }
+    printf("%3d thread(s): %10.5lf s  (%.2fx serial, %.2f GB/s)\n",
+           threads, best, serial_time / best,
+           num_elements * (sizeof(NodeID) + sizeof(SGOffset)) / best / 1e9);
+  }
+  return 0;
+}
@@ -0,0 +1,276 @@
+/*
+ * Alternative layouts of the temporal CSR for the walk engine (rwalk.h),
+ * built from a CSRGraph (walk_layout in the params files).
+ *
+ * SoATemporalCSR: the structure-of-arrays layout of the GPU walker
+ * (v_list / w_list / p_scan_list in src_gpu/rwalk.h). The edge times and
+ * destinations are separate contiguous arrays sharing one 64-bit offset
+ * array, in the CSR's neighbor order. The temporal filter and the bias
+ * weights stream the times only, which are contiguous for SIMD; the
+ * destination array is only read for the chosen edge.
+ *
+ * CompressedTemporalCSR: every node's out-edges are sorted by (time,
+ * neighbor) and stored as one byte block: the degree, then per edge the
+ * time delta and the zigzag neighbor delta to the previous edge, all
+ * varint encoded. Times are quantized to an integer number of
+ * time_resolution steps after the graph's epoch (its earliest time),
+ * which is exact for integer timestamps at resolution 1. The blocks are
+ * indexed by 64-bit byte offsets instead of CSRGraph's pointer array.
+ * out_degree() and out_neigh() have the same shape as CSRGraph's;
+ * out_neigh() decodes the block into a per-thread buffer that stays
+ * valid until the next call on the same thread.
+ *
+ * TimeWindowView: the out-edges of a CSRGraph with times in [t0, t1),
+ * without copying them (walk_time_window). Needs neighborhoods sorted by
+ * time, as BuilderBase builds them; every node's window is found by two
+ * binary searches and kept as a pair of pointers into the graph, which
+ * must outlive the view.
+ *
+ * The SoA and compressed layouts can be built from a CSRGraph or from a
+ * TimeWindowView.
+ */
+
+// Out-edges of a node as a WNode range, like CSRGraph::Neighborhood
+class WNodeRange {
+ public:
+  WNodeRange(const WNode *begin, const WNode *end) : begin_(begin), end_(end) {}
+  const WNode* begin() const { return begin_; }
+  const WNode* end() const { return end_; }
+ private:
+  const WNode *begin_;
+  const WNode *end_;
+};
+
+// Half-open time interval [start, end); the default one has every time
+struct TimeWindow {
+  WeightT start = std::numeric_limits<WeightT>::lowest();
+  WeightT end = std::numeric_limits<WeightT>::max();
+  bool all() const {
+    return start == std::numeric_limits<WeightT>::lowest() &&
+           end == std::numeric_limits<WeightT>::max();
+  }
+};
+
+class TimeWindowView {
+ public:
+  TimeWindowView(const WGraph &g, const TimeWindow &window) :
+      num_nodes_(g.num_nodes()), directed_(g.directed()), window_(window),
+      begin_(g.num_nodes()), end_(g.num_nodes()) {
+    Timer t;
+    t.Start();
+    // The builder sorts every neighborhood by time, so the window is
+    // found by binary search without checking that again per view
+    int64_t in_window = 0;
+    auto earlier = [](const WNode &a, const WNode &b) { return a.w < b.w; };
+    #pragma omp parallel for schedule(dynamic, 64) reduction(+:in_window)
+    for(NodeID n = 0; n < num_nodes_; ++n) {
+      const WNode *n_start = g.out_neigh(n).begin();
+      const WNode *n_end = g.out_neigh(n).end();
+      begin_[n] = std::lower_bound(n_start, n_end, WNode(0, window.start), earlier);
+      end_[n] = std::lower_bound(begin_[n], n_end, WNode(0, window.end), earlier);
+      in_window += end_[n] - begin_[n];
+    }
+    num_edges_directed_ = in_window;
+    t.Stop();
+    std::cout << "Time window [" << window.start << ", " << window.end
+              << ") has " << in_window << " of " << g.num_edges_directed()
+              << " directed edges" << std::endl;
+    PrintStep("[TimingStat] Time window view time (s):", t.Seconds());
+  }
+
+  bool directed() const { return directed_; }
+  int64_t num_nodes() const { return num_nodes_; }
+  int64_t num_edges() const {
+    return directed_ ? num_edges_directed_ : num_edges_directed_ / 2;
+  }
+  int64_t num_edges_directed() const { return num_edges_directed_; }
+  const TimeWindow& window() const { return window_; }
+  int64_t out_degree(NodeID n) const { return end_[n] - begin_[n]; }
+  WNodeRange out_neigh(NodeID n) const { return WNodeRange(begin_[n], end_[n]); }
+
+  bool EdgeExists(NodeID src_node, NodeID dst_node) const {
+    for(auto v : out_neigh(src_node))
+      if(v.v == dst_node)
+        return true;
+    return false;
+  }
+
+ private:
+  int64_t num_nodes_;
+  bool directed_;
+  int64_t num_edges_directed_ = 0;
+  TimeWindow window_;
+  pvector<const WNode*> begin_;
+  pvector<const WNode*> end_;
+};
+
+class SoATemporalCSR {
+ public:
+  template <typename GraphT>
+  explicit SoATemporalCSR(const GraphT &g) :
+      num_nodes_(g.num_nodes()), num_edges_(g.num_edges()),
+      directed_(g.directed()), offsets_(g.num_nodes() + 1),
+      dsts_(g.num_edges_directed()), times_(g.num_edges_directed()) {
+    Timer t;
+    t.Start();
+    #pragma omp parallel for
+    for(NodeID n = 0; n < num_nodes_; ++n)
+      offsets_[n] = g.out_degree(n);
+    ParallelScan(offsets_.data(), num_nodes_, offsets_.data());
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(NodeID n = 0; n < num_nodes_; ++n) {
+      SGOffset e = offsets_[n];
+      for(auto v : g.out_neigh(n)) {
+        dsts_[e] = v.v;
+        times_[e] = v.w;
+        e++;
+      }
+    }
+    t.Stop();
+    PrintStep("[TimingStat] SoA CSR build time (s):", t.Seconds());
+  }
+
+  bool directed() const { return directed_; }
+  int64_t num_nodes() const { return num_nodes_; }
+  int64_t num_edges() const { return num_edges_; }
+  int64_t num_edges_directed() const {
+    return directed_ ? num_edges_ : 2 * num_edges_;
+  }
+  int64_t out_degree(NodeID n) const { return offsets_[n + 1] - offsets_[n]; }
+  const WeightT* out_times(NodeID n) const { return times_.data() + offsets_[n]; }
+  const NodeID* out_dests(NodeID n) const { return dsts_.data() + offsets_[n]; }
+
+ private:
+  int64_t num_nodes_;
+  int64_t num_edges_;
+  bool directed_;
+  pvector<SGOffset> offsets_;
+  pvector<NodeID> dsts_;
+  pvector<WeightT> times_;
+};
+
+class CompressedTemporalCSR {
+ public:
+  template <typename GraphT>
+  CompressedTemporalCSR(const GraphT &g, double time_resolution) :
+      num_nodes_(g.num_nodes()), num_edges_(g.num_edges()),
+      directed_(g.directed()), resolution_(time_resolution),
+      offsets_(g.num_nodes() + 1) {
+    Timer t;
+    t.Start();
+    WeightT epoch = std::numeric_limits<WeightT>::max();
+    #pragma omp parallel for reduction(min:epoch)
+    for(NodeID n = 0; n < num_nodes_; ++n)
+      for(auto v : g.out_neigh(n))
+        epoch = std::min(epoch, v.w);
+    epoch_ = (g.num_edges() > 0) ? epoch : 0;
+
+    // Block sizes, then the blocks at their prefix-summed offsets
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(NodeID n = 0; n < num_nodes_; ++n)
+      offsets_[n] = EncodeNode(g, n, nullptr);
+    ParallelScan(offsets_.data(), num_nodes_, offsets_.data());
+    bytes_.resize(offsets_[num_nodes_]);
+    #pragma omp parallel for schedule(dynamic, 64)
+    for(NodeID n = 0; n < num_nodes_; ++n)
+      EncodeNode(g, n, bytes_.data() + offsets_[n]);
+    t.Stop();
+
+    int64_t csr_bytes = (num_nodes_ + 1) * sizeof(WNode*) +
+                        g.num_edges_directed() * sizeof(WNode);
+    std::cout << "Compressed CSR: " << size_bytes() << " bytes ("
+              << (double) size_bytes() / std::max<int64_t>(csr_bytes, 1)
+              << " of the CSR's " << csr_bytes << ")" << std::endl;
+    PrintStep("[TimingStat] Compressed CSR build time (s):", t.Seconds());
+  }
+
+  bool directed() const { return directed_; }
+  int64_t num_nodes() const { return num_nodes_; }
+  int64_t num_edges() const { return num_edges_; }
+  int64_t num_edges_directed() const {
+    return directed_ ? num_edges_ : 2 * num_edges_;
+  }
+  int64_t size_bytes() const {
+    return offsets_.size() * sizeof(uint64_t) + bytes_.size();
+  }
+
+  int64_t out_degree(NodeID n) const {
+    const uint8_t *p = bytes_.data() + offsets_[n];
+    return ReadVarint(p);
+  }
+
+  // Neighbors in increasing time order
+  WNodeRange out_neigh(NodeID n) const {
+    static thread_local std::vector<WNode> buffer;
+    const uint8_t *p = bytes_.data() + offsets_[n];
+    int64_t degree = ReadVarint(p);
+    if((int64_t) buffer.size() < degree)
+      buffer.resize(degree);
+    uint64_t q = 0;
+    NodeID dst = n;
+    for(int64_t i = 0; i < degree; ++i) {
+      q += ReadVarint(p);
+      dst += UnZigZag(ReadVarint(p));
+      buffer[i].v = dst;
+      buffer[i].w = (WeightT) (epoch_ + q * resolution_);
+    }
+    return WNodeRange(buffer.data(), buffer.data() + degree);
+  }
+
+ private:
+  int64_t num_nodes_;
+  int64_t num_edges_;
+  bool directed_;
+  WeightT epoch_ = 0;
+  double resolution_;
+  pvector<uint64_t> offsets_;
+  std::vector<uint8_t> bytes_;
+
+  static uint64_t ZigZag(int64_t x) { return ((uint64_t) x << 1) ^ (uint64_t) (x >> 63); }
+  static int64_t UnZigZag(uint64_t x) { return (int64_t) (x >> 1) ^ -(int64_t) (x & 1); }
+
+  // Writes x to out (if not null) and returns its encoded length
+  static int64_t WriteVarint(uint64_t x, uint8_t *out) {
+    int64_t len = 0;
+    while(x >= 0x80) {
+      if(out) out[len] = (uint8_t) (x | 0x80);
+      x >>= 7;
+      len++;
+    }
+    if(out) out[len] = (uint8_t) x;
+    return len + 1;
+  }
+
+  static uint64_t ReadVarint(const uint8_t *&p) {
+    uint64_t x = *p & 0x7f;
+    int shift = 7;
+    while(*p++ & 0x80) {
+      x |= (uint64_t) (*p & 0x7f) << shift;
+      shift += 7;
+    }
+    return x;
+  }
+
+  /*
+    Encodes the block of node n into out and returns its size in bytes;
+    only computes the size if out is null
+  */
+  template <typename GraphT>
+  int64_t EncodeNode(const GraphT &g, NodeID n, uint8_t *out) const {
+    static thread_local std::vector<std::pair<uint64_t, NodeID>> edges;
+    edges.clear();
+    for(auto v : g.out_neigh(n))
+      edges.emplace_back((uint64_t) std::llround(((double) v.w - epoch_) / resolution_), v.v);
+    std::sort(edges.begin(), edges.end());
+    int64_t len = WriteVarint(edges.size(), out);
+    uint64_t prev_q = 0;
+    NodeID prev_dst = n;
+    for(auto &e : edges) {
+      len += WriteVarint(e.first - prev_q, out ? out + len : nullptr);
+      len += WriteVarint(ZigZag(e.second - prev_dst), out ? out + len : nullptr);
+      prev_q = e.first;
+      prev_dst = e.second;
+    }
+    return len;
+  }
+};
@@ -0,0 +1,114 @@
+/*
+ * Exact top-K candidate link retrieval over node embeddings.
+ * For a set of query nodes, the cosine similarity to every embedding is
+ * computed with a blocked GEMM over the embedding matrix: a block of
+ * queries is multiplied with one block of embedding rows at a time, so a
+ * row is loaded once for all queries of the block. Every thread keeps its
+ * own top-K heap per query; the heaps are merged at the end of the block.
+ */
+
+const int64_t kQueryBlock = 32;
+const int64_t kRowBlock = 256;
+
+typedef TopKHeap<NodeID, float> LinkHeap;
+typedef std::vector<std::pair<float, NodeID>> LinkCandidates;
+
+/*
+  Inverse L2 norms of all embedding rows (0 for all-zero rows)
+*/
+std::vector<float> InverseRowNorms(const EmbeddingTable &emb)
+{
+  std::vector<float> inv_norm(emb.count());
+  int64_t dim = emb.dim();
+  #pragma omp parallel for schedule(static)
+  for (int64_t r = 0; r < emb.count(); r++) {
+    const float *row = emb.row(r);
+    float sum = 0;
+    #pragma omp simd reduction(+:sum)
+    for (int64_t d = 0; d < dim; d++)
+      sum += row[d] * row[d];
+    inv_norm[r] = (sum > 0) ? 1.0f / std::sqrt(sum) : 0.0f;
+  }
+  return inv_norm;
+}
+
+/*
+  Returns, for every query node, the k most similar other nodes (largest
+  cosine similarity first). Nodes already linked to the query in g are
+  skipped when g is given; queries without an embedding get no candidates.
+*/
+std::vector<LinkCandidates> RetrieveTopK(
+  const EmbeddingTable &emb,
+  const std::vector<NodeID> &queries,
+  size_t k,
+  const WGraph *g)
+{
+  int64_t dim = emb.dim();
+  int64_t num_rows = emb.count();
+  int64_t num_queries = queries.size();
+  std::vector<float> inv_norm = InverseRowNorms(emb);
+  std::vector<LinkCandidates> results(num_queries);
+
+  // Normalized query vectors of the current block, row-major
+  std::vector<float> query_block(kQueryBlock * dim);
+  std::vector<int64_t> query_row(kQueryBlock);
+
+  for (int64_t q_begin = 0; q_begin < num_queries; q_begin += kQueryBlock) {
+    int64_t q_len = std::min(kQueryBlock, num_queries - q_begin);
+    for (int64_t q = 0; q < q_len; q++) {
+      query_row[q] = emb.RowOf(queries[q_begin + q]);
+      float scale = (query_row[q] == -1) ? 0.0f : inv_norm[query_row[q]];
+      for (int64_t d = 0; d < dim; d++)
+        query_block[q * dim + d] =
+          (query_row[q] == -1) ? 0.0f : emb.row(query_row[q])[d] * scale;
+    }
+    std::vector<LinkHeap> block_heaps(q_len, LinkHeap(k));
+
+    #pragma omp parallel
+    {
+      std::vector<LinkHeap> heaps(q_len, LinkHeap(k));
+      std::vector<float> sim(kQueryBlock * kRowBlock);
+
+      #pragma omp for schedule(dynamic, 4) nowait
+      for (int64_t r_begin = 0; r_begin < num_rows; r_begin += kRowBlock) {
+        int64_t r_len = std::min(kRowBlock, num_rows - r_begin);
+        // sim[q][r] = query_block[q] . row[r_begin + r]
+        for (int64_t r = 0; r < r_len; r++) {
+          const float *row = emb.row(r_begin + r);
+          for (int64_t q = 0; q < q_len; q++) {
+            const float *qv = query_block.data() + q * dim;
+            float dot = 0;
+            #pragma omp simd reduction(+:dot)
+            for (int64_t d = 0; d < dim; d++)
+              dot += qv[d] * row[d];
+            sim[q * kRowBlock + r] = dot * inv_norm[r_begin + r];
+          }
+        }
+        for (int64_t q = 0; q < q_len; q++) {
+          if (query_row[q] == -1)
+            continue;
+          NodeID src = queries[q_begin + q];
+          for (int64_t r = 0; r < r_len; r++) {
+            float s = sim[q * kRowBlock + r];
+            if (!heaps[q].Accepts(s) || (r_begin + r == query_row[q]))
+              continue;
+            // Existing links are only looked up for would-be candidates
+            NodeID dst = emb.id(r_begin + r);
+            if ((g != nullptr) && (src < g->num_nodes()) &&
+                (dst < g->num_nodes()) && g->EdgeExists(src, dst))
+              continue;
+            heaps[q].Push(dst, s);
+          }
+        }
+      }
+
+      #pragma omp critical
+      for (int64_t q = 0; q < q_len; q++)
+        block_heaps[q].Merge(heaps[q]);
+    }
+
+    for (int64_t q = 0; q < q_len; q++)
+      results[q_begin + q] = block_heaps[q].Sorted();
+  }
+  return results;
+}
@@ -22,6 +22,92 @@ const int vocab_hash_size = 30000000;  // Maximum 30 * 0.7 = 21M words in the vo
 
 typedef float real;                    // Precision of float numbers
 
+// Storage precision of the syn0/syn1/syn1neg matrices. Build with -DEMB_BF16
+// or -DEMB_FP16 to halve their footprint; the SGD kernel always loads rows
+// into real (fp32) registers, accumulates there and rounds on store.
+#if defined(EMB_BF16) || defined(EMB_FP16)
+typedef uint16_t emb_real;
+#else
+typedef real emb_real;
+#endif
+
+#if defined(EMB_BF16)
+const char *emb_precision = "bf16";
+#elif defined(EMB_FP16)
+const char *emb_precision = "fp16";
+#else
+const char *emb_precision = "fp32";
+#endif
+
+#if defined(EMB_BF16)
+// bf16 is the upper half of an fp32, rounded to nearest even
+inline real EmbLoad(emb_real x) {
+  uint32_t bits = (uint32_t)x << 16;
+  real f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+inline emb_real EmbStore(real f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  if ((bits & 0x7fffffff) > 0x7f800000) return (emb_real)((bits >> 16) | 0x40);  // NaN
+  bits += 0x7fff + ((bits >> 16) & 1);
+  return (emb_real)(bits >> 16);
+}
+#elif defined(EMB_FP16)
+// IEEE half precision, rounded to nearest even; values are tiny (|x| < 1)
+// so the overflow path only has to saturate to inf
+inline real EmbLoad(emb_real h) {
+  uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+  uint32_t exp = (h >> 10) & 0x1f;
+  uint32_t mant = h & 0x3ff;
+  uint32_t bits;
+  if (exp == 0x1f) {
+    bits = sign | 0x7f800000 | (mant << 13);
+  } else if (exp != 0) {
+    bits = sign | ((exp + 112) << 23) | (mant << 13);
+  } else if (mant == 0) {
+    bits = sign;
+  } else {
+    // subnormal half, renormalize
+    exp = 113;
+    while ((mant & 0x400) == 0) { mant <<= 1; exp--; }
+    bits = sign | (exp << 23) | ((mant & 0x3ff) << 13);
+  }
+  real f;
+  memcpy(&f, &bits, sizeof(f));
+  return f;
+}
+
+inline emb_real EmbStore(real f) {
+  uint32_t bits;
+  memcpy(&bits, &f, sizeof(bits));
+  uint32_t sign = (bits >> 16) & 0x8000;
+  int32_t exp = (int32_t)((bits >> 23) & 0xff) - 112;
+  uint32_t mant = bits & 0x7fffff;
+  if (((bits >> 23) & 0xff) == 0xff) return (emb_real)(sign | 0x7c00 | (mant ? 0x200 : 0));
+  if (exp >= 0x1f) return (emb_real)(sign | 0x7c00);
+  if (exp <= 0) {
+    if (exp < -10) return (emb_real)sign;
+    mant |= 0x800000;
+    uint32_t shift = 14 - exp;
+    uint32_t half = (mant >> shift);
+    uint32_t rem = mant & ((1u << shift) - 1);
+    uint32_t mid = 1u << (shift - 1);
+    if (rem > mid || (rem == mid && (half & 1))) half++;
+    return (emb_real)(sign | half);
+  }
+  uint32_t half = sign | ((uint32_t)exp << 10) | (mant >> 13);
+  uint32_t rem = mant & 0x1fff;
+  if (rem > 0x1000 || (rem == 0x1000 && (half & 1))) half++;
+  return (emb_real)half;
+}
+#else
+inline real EmbLoad(emb_real x) { return x; }
+inline emb_real EmbStore(real x) { return x; }
+#endif
+
 struct vocab_word {
   long long cn;
   int *point;
@@ -37,11 +123,16 @@ int *vocab_hash;
 long long vocab_max_size = 1000, vocab_size = 0, layer1_size = 100;
 long long train_words = 0, word_count_actual = 0, iter = 5, file_size = 0, classes = 0;
 real alpha = 0.025, starting_alpha, sample = 1e-3;
-real *syn0, *syn1, *syn1neg, *expTable;
+emb_real *syn0, *syn1, *syn1neg;
+real *expTable;
 clock_t start;
 
 bool print_embfile = false;
 
+// Training checkpoint to warm-start from (incremental mode) and file to
+// save the trained model to; both are ignored when empty
+std::string warm_start_file, checkpoint_file;
+
 int hs = 0, negative = 5;
 const int table_size = 1e8;
 int *table;
@@ -256,6 +347,145 @@ void CreateBinaryTree() {
   free(parent_node);
 }
 
+/*
+  Training checkpoint: vocabulary with counts plus the syn0 and syn1neg
+  matrices, always written as real so it can be loaded by a build with a
+  different emb_real. Layout (native endianness):
+    char[8] magic, long long vocab_size, long long layer1_size,
+    vocab_size x { long long cn, int len, char word[len] },
+    vocab_size x layer1_size syn0, vocab_size x layer1_size syn1neg
+*/
+const char kCheckpointMagic[8] = {'W', '2', 'V', 'C', 'K', 'P', 'T', '1'};
+
+struct W2VCheckpoint {
+  long long vocab_size = 0, layer1_size = 0;
+  std::vector<std::string> words;
+  std::vector<long long> counts;
+  std::map<std::string, long long> index;
+  std::vector<real> syn0, syn1neg;
+};
+
+W2VCheckpoint *warm_start = NULL;
+
+void SaveCheckpoint(std::string ckpt_file) {
+  long long a, b;
+  FILE *fo = fopen(ckpt_file.c_str(), "wb");
+  if (fo == NULL) {
+    printf("ERROR: cannot write checkpoint %s\n", ckpt_file.c_str());
+    exit(1);
+  }
+  fwrite(kCheckpointMagic, sizeof(kCheckpointMagic), 1, fo);
+  fwrite(&vocab_size, sizeof(long long), 1, fo);
+  fwrite(&layer1_size, sizeof(long long), 1, fo);
+  for (a = 0; a < vocab_size; a++) {
+    int len = strlen(vocab[a].word);
+    fwrite(&vocab[a].cn, sizeof(long long), 1, fo);
+    fwrite(&len, sizeof(int), 1, fo);
+    fwrite(vocab[a].word, sizeof(char), len, fo);
+  }
+  real *row = (real *)malloc(layer1_size * sizeof(real));
+  for (a = 0; a < vocab_size; a++) {
+    for (b = 0; b < layer1_size; b++) row[b] = EmbLoad(syn0[a * layer1_size + b]);
+    fwrite(row, sizeof(real), layer1_size, fo);
+  }
+  for (a = 0; a < vocab_size; a++) {
+    for (b = 0; b < layer1_size; b++) row[b] = (negative > 0) ? EmbLoad(syn1neg[a * layer1_size + b]) : 0;
+    fwrite(row, sizeof(real), layer1_size, fo);
+  }
+  free(row);
+  fclose(fo);
+  printf("Saved word2vec checkpoint (%lld words) to %s\n", vocab_size, ckpt_file.c_str());
+}
+
+W2VCheckpoint *LoadCheckpoint(std::string ckpt_file) {
+  char magic[sizeof(kCheckpointMagic)];
+  FILE *fin = fopen(ckpt_file.c_str(), "rb");
+  if (fin == NULL) {
+    printf("ERROR: checkpoint file %s not found!\n", ckpt_file.c_str());
+    exit(1);
+  }
+  if ((fread(magic, sizeof(magic), 1, fin) != 1) ||
+      (memcmp(magic, kCheckpointMagic, sizeof(magic)) != 0)) {
+    printf("ERROR: %s is not a word2vec checkpoint\n", ckpt_file.c_str());
+    exit(1);
+  }
+  // Every size is checked against the bytes left, so a corrupt header
+  // cannot drive a huge allocation
+  long long pos = ftell(fin);
+  fseek(fin, 0, SEEK_END);
+  long long left = ftell(fin) - pos;
+  fseek(fin, pos, SEEK_SET);
+  auto corrupt = [&]() {
+    printf("ERROR: checkpoint %s is corrupt or truncated\n", ckpt_file.c_str());
+    exit(1);
+  };
+  W2VCheckpoint *ckpt = new W2VCheckpoint;
+  if ((fread(&ckpt->vocab_size, sizeof(long long), 1, fin) != 1) ||
+      (fread(&ckpt->layer1_size, sizeof(long long), 1, fin) != 1) ||
+      (ckpt->vocab_size < 0) || (ckpt->layer1_size <= 0) ||
+      (ckpt->vocab_size > left / (long long) (sizeof(long long) + sizeof(int))) ||
+      (ckpt->vocab_size > 0 &&
+       ckpt->layer1_size > left / (2 * (long long) sizeof(real) * ckpt->vocab_size)))
+    corrupt();
+  ckpt->words.resize(ckpt->vocab_size);
+  ckpt->counts.resize(ckpt->vocab_size);
+  for (long long a = 0; a < ckpt->vocab_size; a++) {
+    int len = 0;
+    char word[MAX_STRING];
+    if ((fread(&ckpt->counts[a], sizeof(long long), 1, fin) != 1) ||
+        (fread(&len, sizeof(int), 1, fin) != 1) ||
+        (len < 0) || (len >= MAX_STRING) ||
+        (fread(word, sizeof(char), len, fin) != (size_t) len))
+      corrupt();
+    word[len] = 0;
+    ckpt->words[a] = word;
+    ckpt->index[ckpt->words[a]] = a;
+  }
+  ckpt->syn0.resize(ckpt->vocab_size * ckpt->layer1_size);
+  ckpt->syn1neg.resize(ckpt->vocab_size * ckpt->layer1_size);
+  if ((fread(ckpt->syn0.data(), sizeof(real), ckpt->syn0.size(), fin) != ckpt->syn0.size()) ||
+      (fread(ckpt->syn1neg.data(), sizeof(real), ckpt->syn1neg.size(), fin) != ckpt->syn1neg.size()))
+    corrupt();
+  fclose(fin);
+  printf("Loaded word2vec checkpoint (%lld words, dim %lld) from %s\n",
+    ckpt->vocab_size, ckpt->layer1_size, ckpt_file.c_str());
+  return ckpt;
+}
+
+// Adds the checkpoint words (and their counts) to the vocabulary learned
+// from the new corpus, so every previously embedded node keeps a row and
+// negatives are still drawn from the whole graph
+void MergeCheckpointVocab() {
+  long long a, i;
+  char word[MAX_STRING];
+  for (a = 0; a < warm_start->vocab_size; a++) {
+    strncpy(word, warm_start->words[a].c_str(), MAX_STRING - 1);
+    word[MAX_STRING - 1] = 0;
+    i = SearchVocab(word);
+    if (i == -1) {
+      i = AddWordToVocab(word);
+      vocab[i].cn = 0;
+    }
+    vocab[i].cn += warm_start->counts[a];
+  }
+}
+
+// Overwrites the freshly initialized rows of words seen in the checkpoint
+void ApplyCheckpointRows() {
+  long long a, b, r, reused = 0;
+  for (a = 0; a < vocab_size; a++) {
+    auto it = warm_start->index.find(vocab[a].word);
+    if (it == warm_start->index.end()) continue;
+    r = it->second;
+    for (b = 0; b < layer1_size; b++) {
+      syn0[a * layer1_size + b] = EmbStore(warm_start->syn0[r * layer1_size + b]);
+      if (negative > 0) syn1neg[a * layer1_size + b] = EmbStore(warm_start->syn1neg[r * layer1_size + b]);
+    }
+    reused++;
+  }
+  printf("Warm start: reused %lld rows, %lld new words\n", reused, vocab_size - reused);
+}
+
 void LearnVocabFromTrainFile() {
   char word[MAX_STRING];
   FILE *fin;
@@ -268,7 +498,7 @@ void LearnVocabFromTrainFile() {
   }
   vocab_size = 0;
   AddWordToVocab((char *)"</s>");
-  int cnt=0;
+  long long cnt = 0;
   while (1) {
     ReadWord(word, fin);
     if (feof(fin))
@@ -291,7 +521,11 @@ void LearnVocabFromTrainFile() {
     }
     cnt++;
   }
+  if (warm_start != NULL) MergeCheckpointVocab();
   SortVocab();
+  // Checkpoint counts only shape the vocabulary and the unigram table; the
+  // thread partitioning and learning rate decay follow the new corpus
+  if (warm_start != NULL) train_words = cnt;
   if (debug_mode > 0) {
     printf("Vocab size: %lld\n", vocab_size);
     printf("Words in train file: %lld\n", train_words);
@@ -343,23 +577,23 @@ void ReadVocab() {
 void InitNet() {
   long long a, b;
   unsigned long long next_random = 1;
-  a = posix_memalign((void **)&syn0, 128, (long long)vocab_size * layer1_size * sizeof(real));
+  a = posix_memalign((void **)&syn0, 128, (long long)vocab_size * layer1_size * sizeof(emb_real));
   if (syn0 == NULL) {printf("Memory allocation failed\n"); exit(1);}
   if (hs) {
-    a = posix_memalign((void **)&syn1, 128, (long long)vocab_size * layer1_size * sizeof(real));
+    a = posix_memalign((void **)&syn1, 128, (long long)vocab_size * layer1_size * sizeof(emb_real));
     if (syn1 == NULL) {printf("Memory allocation failed\n"); exit(1);}
     for (a = 0; a < vocab_size; a++) for (b = 0; b < layer1_size; b++)
-     syn1[a * layer1_size + b] = 0;
+     syn1[a * layer1_size + b] = EmbStore(0);
   }
   if (negative>0) {
-    a = posix_memalign((void **)&syn1neg, 128, (long long)vocab_size * layer1_size * sizeof(real));
+    a = posix_memalign((void **)&syn1neg, 128, (long long)vocab_size * layer1_size * sizeof(emb_real));
     if (syn1neg == NULL) {printf("Memory allocation failed\n"); exit(1);}
     for (a = 0; a < vocab_size; a++) for (b = 0; b < layer1_size; b++)
-     syn1neg[a * layer1_size + b] = 0;
+     syn1neg[a * layer1_size + b] = EmbStore(0);
   }
   for (a = 0; a < vocab_size; a++) for (b = 0; b < layer1_size; b++) {
     next_random = next_random * (unsigned long long)25214903917 + 11;
-    syn0[a * layer1_size + b] = (((next_random & 0xFFFF) / (real)65536) - 0.5) / layer1_size;
+    syn0[a * layer1_size + b] = EmbStore((((next_random & 0xFFFF) / (real)65536) - 0.5) / layer1_size);
   }
   CreateBinaryTree();
 }
@@ -433,7 +667,7 @@ void *TrainModelThread(void *id) {
         if (c >= sentence_length) continue;
         last_word = sen[c];
         if (last_word == -1) continue;
-        for (c = 0; c < layer1_size; c++) neu1[c] += syn0[c + last_word * layer1_size];
+        for (c = 0; c < layer1_size; c++) neu1[c] += EmbLoad(syn0[c + last_word * layer1_size]);
         cw++;
       }
       if (cw) {
@@ -442,16 +676,16 @@ void *TrainModelThread(void *id) {
           f = 0;
           l2 = vocab[word].point[d] * layer1_size;
           // Propagate hidden -> output
-          for (c = 0; c < layer1_size; c++) f += neu1[c] * syn1[c + l2];
+          for (c = 0; c < layer1_size; c++) f += neu1[c] * EmbLoad(syn1[c + l2]);
           if (f <= -MAX_EXP) continue;
           else if (f >= MAX_EXP) continue;
           else f = expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))];
           // 'g' is the gradient multiplied by the learning rate
           g = (1 - vocab[word].code[d] - f) * alpha;
           // Propagate errors output -> hidden
-          for (c = 0; c < layer1_size; c++) neu1e[c] += g * syn1[c + l2];
+          for (c = 0; c < layer1_size; c++) neu1e[c] += g * EmbLoad(syn1[c + l2]);
           // Learn weights hidden -> output
-          for (c = 0; c < layer1_size; c++) syn1[c + l2] += g * neu1[c];
+          for (c = 0; c < layer1_size; c++) syn1[c + l2] = EmbStore(EmbLoad(syn1[c + l2]) + g * neu1[c]);
         }
         // NEGATIVE SAMPLING
         if (negative > 0) for (d = 0; d < negative + 1; d++) {
@@ -467,12 +701,12 @@ void *TrainModelThread(void *id) {
           }
           l2 = target * layer1_size;
           f = 0;
-          for (c = 0; c < layer1_size; c++) f += neu1[c] * syn1neg[c + l2];
+          for (c = 0; c < layer1_size; c++) f += neu1[c] * EmbLoad(syn1neg[c + l2]);
           if (f > MAX_EXP) g = (label - 1) * alpha;
           else if (f < -MAX_EXP) g = (label - 0) * alpha;
           else g = (label - expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))]) * alpha;
-          for (c = 0; c < layer1_size; c++) neu1e[c] += g * syn1neg[c + l2];
-          for (c = 0; c < layer1_size; c++) syn1neg[c + l2] += g * neu1[c];
+          for (c = 0; c < layer1_size; c++) neu1e[c] += g * EmbLoad(syn1neg[c + l2]);
+          for (c = 0; c < layer1_size; c++) syn1neg[c + l2] = EmbStore(EmbLoad(syn1neg[c + l2]) + g * neu1[c]);
         }
         // hidden -> in
         for (a = b; a < window * 2 + 1 - b; a++) if (a != window) {
@@ -481,7 +715,7 @@ void *TrainModelThread(void *id) {
           if (c >= sentence_length) continue;
           last_word = sen[c];
           if (last_word == -1) continue;
-          for (c = 0; c < layer1_size; c++) syn0[c + last_word * layer1_size] += neu1e[c];
+          for (c = 0; c < layer1_size; c++) syn0[c + last_word * layer1_size] = EmbStore(EmbLoad(syn0[c + last_word * layer1_size]) + neu1e[c]);
         }
       }
     } else {  //train skip-gram
@@ -492,22 +726,25 @@ void *TrainModelThread(void *id) {
         last_word = sen[c];
         if (last_word == -1) continue;
         l1 = last_word * layer1_size;
+        // neu1 holds an fp32 copy of the input row for the dot products; the
+        // row itself is updated in place below, as other threads write it too
+        for (c = 0; c < layer1_size; c++) neu1[c] = EmbLoad(syn0[c + l1]);
         for (c = 0; c < layer1_size; c++) neu1e[c] = 0;
         // HIERARCHICAL SOFTMAX
         if (hs) for (d = 0; d < vocab[word].codelen; d++) {
           f = 0;
           l2 = vocab[word].point[d] * layer1_size;
           // Propagate hidden -> output
-          for (c = 0; c < layer1_size; c++) f += syn0[c + l1] * syn1[c + l2];
+          for (c = 0; c < layer1_size; c++) f += neu1[c] * EmbLoad(syn1[c + l2]);
           if (f <= -MAX_EXP) continue;
           else if (f >= MAX_EXP) continue;
           else f = expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))];
           // 'g' is the gradient multiplied by the learning rate
           g = (1 - vocab[word].code[d] - f) * alpha;
           // Propagate errors output -> hidden
-          for (c = 0; c < layer1_size; c++) neu1e[c] += g * syn1[c + l2];
+          for (c = 0; c < layer1_size; c++) neu1e[c] += g * EmbLoad(syn1[c + l2]);
           // Learn weights hidden -> output
-          for (c = 0; c < layer1_size; c++) syn1[c + l2] += g * syn0[c + l1];
+          for (c = 0; c < layer1_size; c++) syn1[c + l2] = EmbStore(EmbLoad(syn1[c + l2]) + g * neu1[c]);
         }
         // NEGATIVE SAMPLING
         if (negative > 0) for (d = 0; d < negative + 1; d++) {
@@ -523,15 +760,15 @@ void *TrainModelThread(void *id) {
           }
           l2 = target * layer1_size;
           f = 0;
-          for (c = 0; c < layer1_size; c++) f += syn0[c + l1] * syn1neg[c + l2];
+          for (c = 0; c < layer1_size; c++) f += neu1[c] * EmbLoad(syn1neg[c + l2]);
           if (f > MAX_EXP) g = (label - 1) * alpha;
           else if (f < -MAX_EXP) g = (label - 0) * alpha;
           else g = (label - expTable[(int)((f + MAX_EXP) * (EXP_TABLE_SIZE / MAX_EXP / 2))]) * alpha;
-          for (c = 0; c < layer1_size; c++) neu1e[c] += g * syn1neg[c + l2];
-          for (c = 0; c < layer1_size; c++) syn1neg[c + l2] += g * syn0[c + l1];
+          for (c = 0; c < layer1_size; c++) neu1e[c] += g * EmbLoad(syn1neg[c + l2]);
+          for (c = 0; c < layer1_size; c++) syn1neg[c + l2] = EmbStore(EmbLoad(syn1neg[c + l2]) + g * neu1[c]);
         }
         // Learn weights input -> hidden
-        for (c = 0; c < layer1_size; c++) syn0[c + l1] += neu1e[c];
+        for (c = 0; c < layer1_size; c++) syn0[c + l1] = EmbStore(EmbLoad(syn0[c + l1]) + neu1e[c]);
       }
     }
     sentence_position++;
@@ -547,7 +784,7 @@ void *TrainModelThread(void *id) {
 }
 
 void TrainModel(std::map<int, std::vector<real>>* node_emb) {
-  long a, b, c, d;
+  long a, b;
   FILE *fo;
   pthread_t *pt = (pthread_t *)malloc(num_threads * sizeof(pthread_t));
   // printf("Starting training using file %s\n", train_file.c_str());
@@ -567,12 +804,22 @@ void TrainModel(std::map<int, std::vector<real>>* node_emb) {
   t_w2v.Start();
 
   InitNet();
+  if (warm_start != NULL) {
+    if (warm_start->layer1_size != layer1_size) {
+      printf("ERROR: checkpoint dim %lld does not match layer1_size %lld\n",
+        warm_start->layer1_size, layer1_size);
+      exit(1);
+    }
+    ApplyCheckpointRows();
+  }
   if (negative > 0) InitUnigramTable();
   start = clock();
   for (a = 0; a < num_threads; a++) pthread_create(&pt[a], NULL, TrainModelThread, (void *)a);
   for (a = 0; a < num_threads; a++) pthread_join(pt[a], NULL);
+  free(pt);
   t_w2v.Stop();
   PrintStep("\n[TimingStat] Word2vec time (s):", t_w2v.Seconds());
+  if (!checkpoint_file.empty()) SaveCheckpoint(checkpoint_file);
   std::vector<real> this_emb;
   fo = fopen(output_file.c_str(), "wb");
   if (classes == 0) {
@@ -588,15 +835,18 @@ void TrainModel(std::map<int, std::vector<real>>* node_emb) {
         }
         if (binary)
         {
-          for (b = 0; b < layer1_size; b++) fwrite(&syn0[a * layer1_size + b], sizeof(real), 1, fo);
+          for (b = 0; b < layer1_size; b++) {
+            real v = EmbLoad(syn0[a * layer1_size + b]);
+            fwrite(&v, sizeof(real), 1, fo);
+          }
         }
         else 
         {
           for (b = 0; b < layer1_size; b++) 
           {
-            this_emb.push_back(syn0[a * layer1_size + b]);
+            this_emb.push_back(EmbLoad(syn0[a * layer1_size + b]));
             if(print_embfile)
-              fprintf(fo, "%lf ", syn0[a * layer1_size + b]);
+              fprintf(fo, "%lf ", this_emb.back());
           }
           if(strcmp(vocab[a].word, "</s>") != 0)  // Don't care about storing embedding for </s>
           {
@@ -609,47 +859,13 @@ void TrainModel(std::map<int, std::vector<real>>* node_emb) {
     }
   } else {
     // Run K-means on the word vectors
-    int clcn = classes, iter = 10, closeid;
-    int *centcn = (int *)malloc(classes * sizeof(int));
-    int *cl = (int *)calloc(vocab_size, sizeof(int));
-    real closev, x;
-    real *cent = (real *)calloc(classes * layer1_size, sizeof(real));
-    for (a = 0; a < vocab_size; a++) cl[a] = a % clcn;
-    for (a = 0; a < iter; a++) {
-      for (b = 0; b < clcn * layer1_size; b++) cent[b] = 0;
-      for (b = 0; b < clcn; b++) centcn[b] = 1;
-      for (c = 0; c < vocab_size; c++) {
-        for (d = 0; d < layer1_size; d++) cent[layer1_size * cl[c] + d] += syn0[c * layer1_size + d];
-        centcn[cl[c]]++;
-      }
-      for (b = 0; b < clcn; b++) {
-        closev = 0;
-        for (c = 0; c < layer1_size; c++) {
-          cent[layer1_size * b + c] /= centcn[b];
-          closev += cent[layer1_size * b + c] * cent[layer1_size * b + c];
-        }
-        closev = sqrt(closev);
-        for (c = 0; c < layer1_size; c++) cent[layer1_size * b + c] /= closev;
-      }
-      for (c = 0; c < vocab_size; c++) {
-        closev = -10;
-        closeid = 0;
-        for (d = 0; d < clcn; d++) {
-          x = 0;
-          for (b = 0; b < layer1_size; b++) x += cent[layer1_size * d + b] * syn0[c * layer1_size + b];
-          if (x > closev) {
-            closev = x;
-            closeid = d;
-          }
-        }
-        cl[c] = closeid;
-      }
-    }
+    std::vector<float> vectors(vocab_size * layer1_size);
+    for (a = 0; a < vocab_size * layer1_size; a++) vectors[a] = EmbLoad(syn0[a]);
+    std::vector<int> cl;
+    std::vector<float> cent;
+    SphericalKMeans(vectors.data(), vocab_size, layer1_size, classes, 10, 0, 1, &cl, &cent);
     // Save the K-means classes
     for (a = 0; a < vocab_size; a++) fprintf(fo, "%s %d\n", vocab[a].word, cl[a]);
-    free(centcn);
-    free(cent);
-    free(cl);
   }
   fclose(fo);
 }
@@ -745,6 +961,37 @@ int main(int argc, char **argv) {
 }
 */
 
+/*
+  Frees the vocabulary and the model and restores the training state
+  (learning rate, word counters), so that the next custom_word2vec call
+  trains a new model from scratch, e.g. one per snapshot window
+*/
+void FreeModel() {
+  for (long long a = 0; a < vocab_size; a++) {
+    free(vocab[a].word);
+    free(vocab[a].code);
+    free(vocab[a].point);
+  }
+  free(vocab);
+  free(vocab_hash);
+  free(expTable);
+  free(syn0);
+  free(syn1);
+  free(syn1neg);
+  free(table);
+  vocab = NULL;
+  vocab_hash = NULL;
+  expTable = NULL;
+  syn0 = syn1 = syn1neg = NULL;
+  table = NULL;
+  vocab_max_size = 1000;
+  vocab_size = 0;
+  train_words = 0;
+  word_count_actual = 0;
+  min_reduce = 1;
+  alpha = starting_alpha;
+}
+
 void custom_word2vec(
   std::map<int, std::vector<real>>* node_emb,
   std::string train_file_in,
@@ -755,7 +1002,9 @@ void custom_word2vec(
   int iter_in,
   int cbow_in,
   int num_threads_in,
-  bool print_embfile_in)
+  bool print_embfile_in,
+  std::string warm_start_file_in = "",
+  std::string checkpoint_file_in = "")
 {
   train_file = train_file_in;
   output_file = output_file_in;
@@ -766,6 +1015,9 @@ void custom_word2vec(
   iter = iter_in;
   num_threads = num_threads_in;
   print_embfile = print_embfile_in;
+  warm_start_file = warm_start_file_in;
+  checkpoint_file = checkpoint_file_in;
+  printf("Embedding storage precision: %s\n", emb_precision);
   vocab = (struct vocab_word *)calloc(vocab_max_size, sizeof(struct vocab_word));
   vocab_hash = (int *)calloc(vocab_hash_size, sizeof(int));
   expTable = (real *)malloc((EXP_TABLE_SIZE + 1) * sizeof(real));
@@ -773,5 +1025,11 @@ void custom_word2vec(
     expTable[i] = exp((i / (real)EXP_TABLE_SIZE * 2 - 1) * MAX_EXP); // Precompute the exp() table
     expTable[i] = expTable[i] / (expTable[i] + 1);                   // Precompute f(x) = x / (x + 1)
   }
+  if (!warm_start_file.empty()) warm_start = LoadCheckpoint(warm_start_file);
   TrainModel(node_emb);
-}
\ No newline at end of file
+  if (warm_start != NULL) {
+    delete warm_start;
+    warm_start = NULL;
+  }
+  FreeModel();
+}
@@ -83,49 +83,11 @@ class BuilderBase {
     return degrees;
   }
 
-  static
-  pvector<SGOffset> PrefixSum(const pvector<NodeID_> &degrees) {
-    pvector<SGOffset> sums(degrees.size() + 1);
-    SGOffset total = 0;
-    for (size_t n=0; n < degrees.size(); n++) {
-      sums[n] = total;
-      total += degrees[n];
-    }
-    sums[degrees.size()] = total;
-    return sums;
-  }
-
+  // Vertex offsets by a prefix sum over the degrees (ParallelScan)
   static
   pvector<SGOffset> ParallelPrefixSum(const pvector<NodeID_> &degrees) {
-    const size_t block_size = 1<<20;
-    const size_t num_blocks = (degrees.size() + block_size - 1) / block_size;
-    pvector<SGOffset> local_sums(num_blocks);
-    #pragma omp parallel for
-    for (size_t block=0; block < num_blocks; block++) {
-      SGOffset lsum = 0;
-      size_t block_end = std::min((block + 1) * block_size, degrees.size());
-      for (size_t i=block * block_size; i < block_end; i++)
-        lsum += degrees[i];
-      local_sums[block] = lsum;
-    }
-    pvector<SGOffset> bulk_prefix(num_blocks+1);
-    SGOffset total = 0;
-    for (size_t block=0; block < num_blocks; block++) {
-      bulk_prefix[block] = total;
-      total += local_sums[block];
-    }
-    bulk_prefix[num_blocks] = total;
     pvector<SGOffset> prefix(degrees.size() + 1);
-    #pragma omp parallel for
-    for (size_t block=0; block < num_blocks; block++) {
-      SGOffset local_total = bulk_prefix[block];
-      size_t block_end = std::min((block + 1) * block_size, degrees.size());
-      for (size_t i=block * block_size; i < block_end; i++) {
-        prefix[i] = local_total;
-        local_total += degrees[i];
-      }
-    }
-    prefix[degrees.size()] = bulk_prefix[num_blocks];
+    ParallelScan(degrees.data(), degrees.size(), prefix.data());
     return prefix;
   }
 
@@ -212,19 +212,21 @@ void compute_random_walk(
   num_of_edges = g.num_edges();
 
   p_scan_list = new int64_t [num_of_nodes + 1];
-  p_scan_list[0] = 0;
   v_list = new int64_t[num_of_edges];
   w_list = new float[num_of_edges];
   
   std::cout << "Generating parallel scan list and data structures for GPU..." << std::endl;
+  #pragma omp parallel for
+  for(NodeID i = 0; i < num_of_nodes; ++i)
+    p_scan_list[i] = g.out_degree(i);
+  ParallelScan(p_scan_list, num_of_nodes, p_scan_list);
+  #pragma omp parallel for schedule(dynamic, 64)
   for(NodeID i = 0; i < num_of_nodes; ++i) {
-    p_scan_list[i + 1] = p_scan_list[i] + g.out_degree(i);
-    int cnt = 0;
+    int64_t idx = p_scan_list[i];
     for(auto v: g.out_neigh(i)){
-      int64_t idx = p_scan_list[i] + cnt;
       v_list[idx] = v.v;
       w_list[idx] = v.w;
-      cnt++;
+      idx++;
     }
   }
 
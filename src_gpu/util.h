@@ -5,8 +5,10 @@
 #define UTIL_H_
 
 #include <stdio.h>
+#include <algorithm>
 #include <cinttypes>
 #include <string>
+#include <vector>
 
 #include "timer.h"
 
@@ -82,4 +84,43 @@ class Range{
   RangeIter<T_> end() const { return RangeIter<T_>(to_); }
 };
 
+
+// Elements per block of ParallelScan; smaller inputs are scanned serially
+static const size_t kScanBlockSize = 1 << 16;
+
+/*
+Exclusive prefix sum: out[i] = in[0] + ... + in[i-1] for 0 <= i <= n, so
+out has n + 1 elements and out[n] is the total. out may be in itself.
+ - Sum every block in parallel (vectorized)
+ - Scan the block sums serially
+ - Scan every block in parallel starting from its block's offset
+*/
+template <typename InT_, typename OutT_>
+void ParallelScan(const InT_ *in, size_t n, OutT_ *out) {
+  const size_t num_blocks = (n + kScanBlockSize - 1) / kScanBlockSize;
+  std::vector<OutT_> block_offsets(num_blocks + 1, 0);
+  #pragma omp parallel for schedule(static) if (num_blocks > 1)
+  for (size_t block=0; block < num_blocks; block++) {
+    size_t block_end = std::min((block + 1) * kScanBlockSize, n);
+    OutT_ sum = 0;
+    #pragma omp simd reduction(+:sum)
+    for (size_t i=block * kScanBlockSize; i < block_end; i++)
+      sum += in[i];
+    block_offsets[block + 1] = sum;
+  }
+  for (size_t block=0; block < num_blocks; block++)
+    block_offsets[block + 1] += block_offsets[block];
+  #pragma omp parallel for schedule(static) if (num_blocks > 1)
+  for (size_t block=0; block < num_blocks; block++) {
+    size_t block_end = std::min((block + 1) * kScanBlockSize, n);
+    OutT_ total = block_offsets[block];
+    for (size_t i=block * kScanBlockSize; i < block_end; i++) {
+      OutT_ x = in[i];
+      out[i] = total;
+      total += x;
+    }
+  }
+  out[n] = block_offsets[num_blocks];
+}
+
 #endif  // UTIL_H_